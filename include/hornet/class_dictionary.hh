@@ -0,0 +1,59 @@
+#ifndef HORNET_CLASS_DICTIONARY_HH
+#define HORNET_CLASS_DICTIONARY_HH
+
+#include "hornet/concurrent_table.hh"
+#include "hornet/symbol.hh"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace hornet {
+
+struct klass;
+
+/// Loaded classes keyed by name. Lookups take no locks, and a class is
+/// published at most once per name: a thread that loses a race to register
+/// a class gets the class that won.
+class class_dictionary {
+public:
+    explicit class_dictionary(size_t capacity = 1024);
+    ~class_dictionary();
+
+    class_dictionary(const class_dictionary&) = delete;
+    class_dictionary& operator=(const class_dictionary&) = delete;
+
+    std::shared_ptr<klass> lookup(symbol name) const;
+
+    /// Registers a class unless a class with the same name is already
+    /// registered, and returns the registered class.
+    std::shared_ptr<klass> insert(symbol name, std::shared_ptr<klass> klass);
+
+    /// Calls "fn" with every registered class.
+    void for_each(const std::function<void(klass*)>& fn) const;
+
+    size_t size() const {
+        return _table.size();
+    }
+
+private:
+    struct entry {
+        symbol name;
+        std::shared_ptr<klass> value;
+    };
+
+    struct entry_traits {
+        static size_t hash(const entry& e);
+        static void destroy(entry* e) {
+            delete e;
+        }
+    };
+
+    concurrent_table<entry, entry_traits> _table;
+    std::mutex _insert_mutex;
+};
+
+}
+
+#endif
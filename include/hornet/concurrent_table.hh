@@ -0,0 +1,160 @@
+#ifndef HORNET_CONCURRENT_TABLE_HH
+#define HORNET_CONCURRENT_TABLE_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+
+namespace hornet {
+
+void out_of_memory();
+
+/// An open addressed hash table with linear probing whose lookups take no
+/// locks. It is the storage behind the symbol table, the class dictionary and
+/// the string intern table, which each pick their own locking for inserts.
+///
+/// Entries are never removed and a slot never changes once it is filled, so
+/// readers stop at the first empty slot and entry pointers stay valid for the
+/// lifetime of the table. "Traits" provides:
+///
+///   static size_t hash(const Entry&);  // the hash that add() was given
+///   static void destroy(Entry*);
+template<typename Entry, typename Traits>
+class concurrent_table {
+public:
+    explicit concurrent_table(size_t capacity)
+        : _buckets(new_bucket_array(round_up_pow2(capacity)))
+        , _size(0)
+    { }
+
+    ~concurrent_table() {
+        auto* buckets = _buckets.load(std::memory_order_relaxed);
+        for (size_t idx = 0; idx <= buckets->mask; idx++) {
+            if (auto* e = buckets->slots[idx].load(std::memory_order_relaxed)) {
+                Traits::destroy(e);
+            }
+        }
+        free(buckets);
+        for (auto* retired : _retired) {
+            free(retired);
+        }
+    }
+
+    concurrent_table(const concurrent_table&) = delete;
+    concurrent_table& operator=(const concurrent_table&) = delete;
+
+    /// Returns the entry with hash "hash" for which "match" returns true, or
+    /// nullptr if there is none.
+    template<typename Match>
+    Entry* find(size_t hash, Match match) const {
+        auto* buckets = _buckets.load(std::memory_order_acquire);
+        for (size_t idx = hash & buckets->mask;; idx = (idx + 1) & buckets->mask) {
+            auto* e = buckets->slots[idx].load(std::memory_order_acquire);
+            if (!e) {
+                return nullptr;
+            }
+            if (match(*e)) {
+                return e;
+            }
+        }
+    }
+
+    /// Publishes an entry and returns the number of entries in the table.
+    /// Callers must hold a lock that keeps other threads from adding an
+    /// equal entry and from calling grow().
+    size_t add(size_t hash, Entry* e) {
+        auto* buckets = _buckets.load(std::memory_order_acquire);
+        for (size_t idx = hash & buckets->mask;; idx = (idx + 1) & buckets->mask) {
+            Entry* expected = nullptr;
+            if (buckets->slots[idx].compare_exchange_strong(expected, e, std::memory_order_release, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        return _size.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    /// Doubles the capacity. Lock-free readers may still be probing the old
+    /// bucket array, so it is kept until the table is destroyed. Callers must
+    /// keep other threads from calling add() or grow().
+    void grow() {
+        auto* old_buckets = _buckets.load(std::memory_order_relaxed);
+        auto capacity = old_buckets->mask + 1;
+        auto* buckets = new_bucket_array(2 * capacity);
+        for (size_t idx = 0; idx < capacity; idx++) {
+            auto* e = old_buckets->slots[idx].load(std::memory_order_relaxed);
+            if (!e) {
+                continue;
+            }
+            auto slot = Traits::hash(*e) & buckets->mask;
+            while (buckets->slots[slot].load(std::memory_order_relaxed)) {
+                slot = (slot + 1) & buckets->mask;
+            }
+            buckets->slots[slot].store(e, std::memory_order_relaxed);
+        }
+        _buckets.store(buckets, std::memory_order_release);
+        _retired.push_back(old_buckets);
+    }
+
+    /// Calls "fn" with every entry.
+    template<typename Fn>
+    void for_each(Fn fn) const {
+        auto* buckets = _buckets.load(std::memory_order_acquire);
+        for (size_t idx = 0; idx <= buckets->mask; idx++) {
+            if (auto* e = buckets->slots[idx].load(std::memory_order_acquire)) {
+                fn(e);
+            }
+        }
+    }
+
+    /// Calls "fn" with every entry and the length of the probe sequence that
+    /// finds it.
+    template<typename Fn>
+    void for_each_probe(Fn fn) const {
+        auto* buckets = _buckets.load(std::memory_order_acquire);
+        for (size_t idx = 0; idx <= buckets->mask; idx++) {
+            if (auto* e = buckets->slots[idx].load(std::memory_order_acquire)) {
+                fn(e, ((idx - Traits::hash(*e)) & buckets->mask) + 1);
+            }
+        }
+    }
+
+    size_t size() const {
+        return _size.load(std::memory_order_relaxed);
+    }
+
+    size_t capacity() const {
+        return _buckets.load(std::memory_order_acquire)->mask + 1;
+    }
+
+private:
+    struct bucket_array {
+        size_t mask;
+        std::atomic<Entry*> slots[];
+    };
+
+    static bucket_array* new_bucket_array(size_t capacity) {
+        auto* buckets = static_cast<bucket_array*>(calloc(1, sizeof(bucket_array) + capacity * sizeof(std::atomic<Entry*>)));
+        if (!buckets) {
+            out_of_memory();
+        }
+        buckets->mask = capacity - 1;
+        return buckets;
+    }
+
+    static size_t round_up_pow2(size_t n) {
+        size_t ret = 1;
+        while (ret < n) {
+            ret <<= 1;
+        }
+        return ret;
+    }
+
+    std::atomic<bucket_array*> _buckets;
+    std::atomic<size_t> _size;
+    std::vector<bucket_array*> _retired;
+};
+
+}
+
+#endif
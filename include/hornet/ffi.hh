@@ -13,6 +13,6 @@ void ffi_java_init();
 
 void* ffi_java_sym(method* m);
 
-ffi_type* klass_to_ffi_type(klass*);
+ffi_type* type_to_ffi_type(type t);
 
 }
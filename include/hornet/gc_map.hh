@@ -0,0 +1,116 @@
+#ifndef HORNET_GC_MAP_HH
+#define HORNET_GC_MAP_HH
+
+#include "hornet/translator.hh"
+#include "hornet/vm.hh"
+
+#include <unordered_map>
+#include <vector>
+
+namespace hornet {
+
+/// Computes which local variables and operand stack slots of a method hold
+/// references at its GC points, which are the instructions that can call
+/// into the GC: allocations, calls and class initialization barriers.
+///
+/// The builder runs the method through the translator and tracks the kind of
+/// value in every slot until the slot kinds at basic block entries reach a
+/// fixed point. A slot that holds different kinds of values depending on the
+/// path that reached it is unusable, like in the verifier, so it is not a
+/// reference. Operand stack slots are counted the way execution engines lay
+/// them out, with long and double values taking a single slot.
+class gc_map_builder : public translator {
+public:
+    gc_map_builder(method* method);
+
+    void build();
+
+    /// Returns the GC map of the GC point at bytecode offset "pc". The map
+    /// describes the frame before the instruction executes.
+    const gc_map& map_at(uint16_t pc) const;
+
+protected:
+    virtual void prologue() override;
+    virtual void epilogue() override;
+    virtual void begin(std::shared_ptr<basic_block> bblock) override;
+    virtual void op_const (type t, int64_t value) override;
+    virtual void op_load  (type t, uint16_t idx) override;
+    virtual void op_store (type t, uint16_t idx) override;
+    virtual void op_arrayload(type t) override;
+    virtual void op_arraystore(type t) override;
+    virtual void op_convert(type from, type to) override;
+    virtual void op_pop() override;
+    virtual void op_pop2() override;
+    virtual void op_dup() override;
+    virtual void op_dup_x1() override;
+    virtual void op_dup_x2() override;
+    virtual void op_dup2() override;
+    virtual void op_dup2_x1() override;
+    virtual void op_dup2_x2() override;
+    virtual void op_swap() override;
+    virtual void op_unary(type t, unaryop op) override;
+    virtual void op_binary(type t, binop op) override;
+    virtual void op_iinc(uint8_t idx, jint value) override;
+    virtual void op_lcmp() override;
+    virtual void op_cmp(type t, cmpop op) override;
+    virtual void op_if(type t, cmpop op, std::shared_ptr<basic_block> target) override;
+    virtual void op_if_cmp(type t, cmpop op, std::shared_ptr<basic_block> target) override;
+    virtual void op_goto(std::shared_ptr<basic_block> target) override;
+    virtual void op_tableswitch(uint32_t high, uint32_t low, std::shared_ptr<basic_block> def, const std::vector<std::shared_ptr<basic_block>>& table) override;
+    virtual void op_ret() override;
+    virtual void op_ret_void() override;
+    virtual void op_getstatic(field* field) override;
+    virtual void op_putstatic(field* field) override;
+    virtual void op_getfield(field* field) override;
+    virtual void op_putfield(field* field) override;
+    virtual void op_invokevirtual(method* target) override;
+    virtual void op_invokespecial(method* target) override;
+    virtual void op_invokestatic(method* target) override;
+    virtual void op_invokeinterface(method* target) override;
+    virtual void op_new(klass* klass) override;
+    virtual void op_newarray(uint8_t atype) override;
+    virtual void op_anewarray(klass* klass) override;
+    virtual void op_multianewarray(klass* klass, uint8_t dimensions) override;
+    virtual void op_arraylength() override;
+    virtual void op_athrow() override;
+    virtual void op_checkcast(klass* klass) override;
+    virtual void op_instanceof(klass* klass) override;
+    virtual void op_monitorenter() override;
+    virtual void op_monitorexit() override;
+
+private:
+    enum class slot_kind : uint8_t {
+        /// Uninitialized, or holds different kinds of values on different
+        /// paths.
+        unusable,
+        /// A primitive value that takes one local variable slot.
+        value,
+        /// A long or double value.
+        wide,
+        ref,
+    };
+
+    struct frame_state {
+        std::vector<slot_kind> locals;
+        std::vector<slot_kind> stack;
+    };
+
+    static slot_kind kind_of(type t);
+
+    void push(slot_kind kind);
+    slot_kind pop();
+    void pop(size_t count);
+    void invoke(method* target, bool receiver);
+    void record();
+    void merge(std::shared_ptr<basic_block> bblock);
+
+    frame_state _state;
+    bool _falls_through;
+    std::unordered_map<uint16_t, frame_state> _entry_states;
+    std::vector<std::shared_ptr<basic_block>> _worklist;
+    std::unordered_map<uint16_t, gc_map> _maps;
+};
+
+}
+
+#endif
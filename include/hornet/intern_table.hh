@@ -0,0 +1,95 @@
+#ifndef HORNET_INTERN_TABLE_HH
+#define HORNET_INTERN_TABLE_HH
+
+#include "hornet/concurrent_table.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace hornet {
+
+struct string;
+
+/// Table of interned strings keyed by their modified UTF-8 bytes. Lookups
+/// take no locks. Inserts take one of a fixed number of locks, picked by
+/// hash, and publish entries with a compare-and-swap, so threads that
+/// intern different strings rarely contend.
+class intern_table {
+public:
+    struct stats {
+        size_t size;
+        size_t capacity;
+        /// Longest probe sequence of any entry in the table.
+        size_t max_probe;
+        /// Average probe sequence length of the entries in the table.
+        double avg_probe;
+        size_t resizes;
+    };
+
+    explicit intern_table(size_t capacity = 1024);
+    ~intern_table();
+
+    intern_table(const intern_table&) = delete;
+    intern_table& operator=(const intern_table&) = delete;
+
+    /// Returns the slot of the interned string for the bytes, or nullptr if
+    /// there is none. The bytes are only borrowed for the duration of the
+    /// call.
+    string** lookup(const char* utf8, size_t size, uint32_t hash) const;
+
+    /// Returns the slot of the interned string for the bytes, creating the
+    /// string on first use. The slot lives as long as the table and is a GC
+    /// root, so it always holds the current address of the string and
+    /// translated code can refer to the string through it.
+    string** intern(const char* utf8, size_t size, uint32_t hash);
+
+    string** intern(const char* utf8, size_t size) {
+        return intern(utf8, size, hash_bytes(utf8, size));
+    }
+
+    /// Calls "fn" with the slot of every interned string.
+    void for_each(const std::function<void(string**)>& fn) const;
+
+    stats statistics() const;
+
+    static uint32_t hash_bytes(const char* utf8, size_t size);
+
+private:
+    struct entry {
+        string* value;
+        uint32_t hash;
+        uint32_t size;
+        char utf8[];
+    };
+
+    struct entry_traits {
+        static size_t hash(const entry& e) {
+            return e.hash;
+        }
+        static void destroy(entry* e) {
+            free(e);
+        }
+    };
+
+    static constexpr size_t nr_stripes = 64;
+
+    // Pad the locks to a cache line each so that threads taking different
+    // stripes don't bounce the same line.
+    struct stripe {
+        std::mutex mutex;
+        char pad[64 - sizeof(std::mutex) % 64];
+    };
+
+    void grow();
+
+    concurrent_table<entry, entry_traits> _table;
+    std::atomic<size_t> _resizes;
+    stripe _stripes[nr_stripes];
+};
+
+}
+
+#endif
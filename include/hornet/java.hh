@@ -6,6 +6,7 @@
 
 #include <jni.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
@@ -14,8 +15,11 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <condition_variable>
 #include <mutex>
 #include <stack>
+#include <thread>
+#include <unordered_map>
 
 namespace hornet {
 
@@ -45,15 +49,6 @@ struct cp_info final {
 
     cp_info(cp_tag tag) : tag(tag) { }
 
-    ~cp_info()
-    {
-        switch (tag) {
-        case cp_tag::const_utf8:
-            delete[] bytes;
-            break;
-        }
-    }
-
     cp_info(const cp_info&) = delete;
     cp_info& operator=(const cp_info&) = delete;
 
@@ -73,8 +68,8 @@ struct cp_info final {
         jlong    long_value;
         jfloat   float_value;
         jdouble  double_value;
-        char*    bytes;
     };
+    symbol utf8_value;
 
     static inline
     std::shared_ptr<cp_info> make_class(uint16_t name_index) {
@@ -151,9 +146,9 @@ struct cp_info final {
     }
 
     static inline
-    std::shared_ptr<cp_info> make_utf8_info(char* bytes) {
+    std::shared_ptr<cp_info> make_utf8_info(symbol value) {
         auto ret = std::make_shared<cp_info>(cp_tag::const_utf8);
-        ret->bytes = bytes;
+        ret->utf8_value = value;
         return ret;
     }
 };
@@ -166,6 +161,10 @@ public:
 
     void set(uint16_t idx, std::shared_ptr<cp_info> entry);
 
+    uint16_t size() const {
+        return _entries.size();
+    }
+
     const cp_info& get(uint16_t idx) const;
     const cp_info& get_class(uint16_t idx) const;
     const cp_info& get_fieldref(uint16_t idx) const;
@@ -177,7 +176,7 @@ public:
     jfloat get_float(uint16_t idx) const;
     jdouble get_double(uint16_t idx) const;
     const cp_info& get_utf8(uint16_t idx) const;
-    string *get_string(uint16_t idx) const;
+    string **get_string(uint16_t idx) const;
 
 private:
     template<typename Type, cp_tag Tag>
@@ -186,6 +185,7 @@ private:
 
 enum class attr_type {
     code,
+    runtime_visible_annotations,
     unknown
 };
 
@@ -196,6 +196,7 @@ struct attr_info {
 };
 
 struct code_attr : attr_info {
+    uint16_t max_stack;
     uint16_t max_locals;
     char*    code;
     uint32_t code_length;
@@ -203,6 +204,25 @@ struct code_attr : attr_info {
     code_attr() : attr_info(attr_type::code) {}
 };
 
+struct annotation_element {
+    symbol   name;
+    char     tag;
+    /// Constant pool index of the value for constant elements, or zero for
+    /// enum, class, annotation and array elements.
+    uint16_t const_value_index;
+};
+
+struct annotation {
+    symbol type;
+    std::vector<annotation_element> elements;
+};
+
+struct annotations_attr : attr_info {
+    std::vector<annotation> annotations;
+
+    annotations_attr() : attr_info(attr_type::runtime_visible_annotations) {}
+};
+
 struct unknown_attr : attr_info {
     unknown_attr() : attr_info(attr_type::unknown) {}
 };
@@ -235,6 +255,9 @@ private:
     std::shared_ptr<method> read_method_info(klass* klass, constant_pool &constant_pool);
     std::unique_ptr<attr_info> read_attr_info(constant_pool &constant_pool);
     std::unique_ptr<code_attr> read_code_attribute(constant_pool &constant_pool);
+    std::unique_ptr<annotations_attr> read_annotations_attribute(constant_pool &constant_pool);
+    annotation read_annotation(constant_pool &constant_pool);
+    uint16_t read_element_value(constant_pool &constant_pool, char& tag);
 
     uint8_t  read_u1();
     uint16_t read_u2();
@@ -255,6 +278,18 @@ extern bool verbose_class;
 
 extern bool verbose_verifier;
 
+extern bool overlapping_frames;
+
+extern bool stack_caching;
+
+extern bool direct_threading;
+
+extern bool superinstructions;
+
+extern bool instruction_profile;
+
+void interp_stats();
+
 bool verify_method(std::shared_ptr<method> method);
 void verifier_stats();
 
@@ -303,10 +338,21 @@ private:
 class loader {
 public:
     void register_entry(std::string path);
-    std::shared_ptr<klass> load_class(std::string class_name);
+    std::shared_ptr<klass> load_class(symbol class_name);
+    std::shared_ptr<klass> load_class(const std::string& class_name);
 private:
+    std::shared_ptr<klass> define_class(symbol class_name);
+    bool waits_for_self(symbol class_name) const;
     std::shared_ptr<klass> try_to_load_class(std::string class_name);
     std::vector<std::shared_ptr<classpath_entry>> _entries;
+    /// Classes that are being loaded and the threads loading them. Classes
+    /// are published only after they are linked, so other threads wait here
+    /// instead of seeing a half-built klass.
+    std::unordered_map<symbol, std::thread::id> _loading;
+    /// Classes that threads are waiting for in _loading.
+    std::unordered_map<std::thread::id, symbol> _waiting;
+    std::mutex _loading_mutex;
+    std::condition_variable _loading_done;
 };
 
 class system_loader {
@@ -331,33 +377,51 @@ inline loader *system_loader()
 
 // JVM interpreter frame that has local variables, operand stack, and a program
 // counter. It is constructed at each method invocation and destroyed when an
-// invocation completes.
+// invocation completes. The frame lives in the thread stack between its local
+// variable slots and its operand stack slots, which are sized from the
+// method's max_locals and max_stack:
+//
+//   [ locals ][ struct frame ][ ostack ]
+//
+// The local variables of a callee frame may overlap with the top of the
+// caller's operand stack so that arguments are passed without copying.
+//
+// Frames are linked from the innermost one so that the GC can find the
+// references in them. Before an instruction that can call into the GC, the
+// interpreter stores the translated code offset that follows the instruction
+// in "pc", which is the key to the method's GC maps. A frame whose "pc" is
+// zero has not reached a GC point yet, and only its arguments are live.
 struct frame {
-    std::vector<value_t> locals;
-    std::vector<value_t> ostack;
-    uint16_t             pc;
-
-    frame(size_t size)
-       : locals(size), pc(0)
+    value_t* locals;
+    value_t* ostack;
+    value_t* sp;
+    size_t   prev_stack_pos;
+    uint32_t pc;
+    struct method* method;
+    frame*   prev;
+
+    frame(value_t* locals, value_t* ostack, size_t prev_stack_pos, struct method* method, frame* prev)
+       : locals(locals), ostack(ostack), sp(ostack), prev_stack_pos(prev_stack_pos), pc(0), method(method), prev(prev)
     { }
 
     ~frame()
     { }
 
-    void reserve_more(size_t size) {
-        locals.reserve(locals.size() + size);
-    }
-
     void ostack_push(value_t value) {
-        ostack.push_back(value);
+        *sp++ = value;
     }
 
     void ostack_pop() {
-        ostack.pop_back();
+        sp--;
     }
 
     value_t ostack_top() const {
-        return ostack.back();
+        return sp[-1];
+    }
+
+    // Returns the operand stack value "depth" slots below the top.
+    value_t ostack_peek(size_t depth) const {
+        return sp[-1 - depth];
     }
 };
 
@@ -412,24 +476,75 @@ public:
     ~thread();
 
     object *exception;
+    /// Nonzero identifier of the thread that is recorded as the owner in
+    /// thin locks.
+    const uint32_t id;
 
     static thread *current() {
-        static thread thread;
+        static thread_local thread thread;
 
         return &thread;
     }
 
-    template<typename... Args>
-    frame* make_frame(Args&&... args) {
-        char* raw_frame = _stack + _stack_pos;
-        _stack_pos += sizeof(struct frame);
+    /// Returns the next number from the thread-local xorshift generator that
+    /// identity hash codes are drawn from.
+    uint32_t next_hash() {
+        auto x = _hash_state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        _hash_state = x;
+        return x;
+    }
+
+    /// Sets up the thread for running Java code. Threads that the VM did not
+    /// start attach implicitly the first time they allocate.
+    void attach();
+
+    /// Releases the per-thread VM resources before the thread exits.
+    void detach();
+
+    /// Returns the MPS allocation point that the thread allocates objects
+    /// from. Every thread has its own so that allocation does not contend.
+    mps_ap_s* alloc_point() {
+        if (!_alloc_point) {
+            attach();
+        }
+        return _alloc_point;
+    }
+
+    /// Returns the innermost Java frame of the thread, or nullptr if the
+    /// thread is not running Java code.
+    frame* top_frame() const {
+        return _top_frame;
+    }
+
+    frame* make_frame(method* method) {
+        auto* locals = reinterpret_cast<value_t*>(_stack + _stack_pos);
+        return make_frame(locals, method);
+    }
+
+    // Make a frame whose local variables start at "locals", which may point
+    // to arguments on top of the caller's operand stack.
+    frame* make_frame(value_t* locals, method* method) {
+        if (!_top_frame) {
+            // The GC needs to know about the thread before it runs Java code.
+            attach();
+        }
+        char* raw_frame = reinterpret_cast<char*>(locals + method->max_locals);
+        auto* ostack = reinterpret_cast<value_t*>(raw_frame + sizeof(struct frame));
+        auto prev_stack_pos = _stack_pos;
+        auto end = static_cast<size_t>(reinterpret_cast<char*>(ostack + method->max_stack) - _stack);
+        _stack_pos = std::max(_stack_pos, end);
         assert(_stack_pos < _stack_max);
-        return new (raw_frame) frame(std::forward<Args>(args)...);
+        _top_frame = new (raw_frame) frame(locals, ostack, prev_stack_pos, method, _top_frame);
+        return _top_frame;
     }
 
     void free_frame(frame* frame) {
+        _stack_pos = frame->prev_stack_pos;
+        _top_frame = frame->prev;
         frame->~frame();
-        _stack_pos -= sizeof(struct frame);
     }
 
 private:
@@ -439,6 +554,11 @@ private:
     static constexpr size_t _stack_max = 1024*1024; /* 1 MB */
     size_t _stack_pos;
     char* _stack;
+    uint32_t _hash_state;
+    mps_ap_s* _alloc_point;
+    mps_thr_s* _gc_thread;
+    mps_root_s* _gc_root;
+    frame* _top_frame;
 };
 
 inline void throw_exception(struct object *exception)
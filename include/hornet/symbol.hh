@@ -0,0 +1,85 @@
+#ifndef HORNET_SYMBOL_HH
+#define HORNET_SYMBOL_HH
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace hornet {
+
+class symbol;
+
+/// Returns the symbol for a string and adds the string to the symbol table
+/// if it is not there yet.
+symbol intern(const std::string& str);
+
+/// Returns the symbol for a string or a null symbol if the string is not in
+/// the symbol table.
+symbol lookup_symbol(const std::string& str);
+
+/// An interned string that is used for class, method and field names and
+/// descriptors. The VM-wide symbol table has exactly one copy of every
+/// string, so symbols are compared and hashed by pointer.
+class symbol {
+public:
+    symbol()
+        : _str(nullptr)
+    { }
+
+    const std::string& str() const {
+        return *_str;
+    }
+
+    const char* c_str() const {
+        return _str->c_str();
+    }
+
+    size_t size() const {
+        return _str->size();
+    }
+
+    char operator[](size_t pos) const {
+        return (*_str)[pos];
+    }
+
+    explicit operator bool() const {
+        return _str != nullptr;
+    }
+
+    bool operator==(symbol other) const {
+        return _str == other._str;
+    }
+
+    bool operator!=(symbol other) const {
+        return _str != other._str;
+    }
+
+    size_t hash() const {
+        return std::hash<const std::string*>()(_str);
+    }
+
+private:
+    explicit symbol(const std::string* str)
+        : _str(str)
+    { }
+
+    friend symbol intern(const std::string& str);
+    friend symbol lookup_symbol(const std::string& str);
+
+    const std::string* _str;
+};
+
+}
+
+namespace std {
+
+template<>
+struct hash<hornet::symbol> {
+    size_t operator()(hornet::symbol sym) const {
+        return sym.hash();
+    }
+};
+
+}
+
+#endif
@@ -66,6 +66,7 @@ class translator {
 public:
     translator(method* method)
         : _method(method)
+        , _insn_pc(0)
     { }
 
     virtual ~translator() { }
@@ -89,6 +90,9 @@ protected:
     virtual void prologue () = 0;
     virtual void epilogue () = 0;
     virtual void begin(std::shared_ptr<basic_block> bblock) = 0;
+    // Reference constants are passed as the address of a slot that holds the
+    // reference, or zero for null. The GC updates the slot when it moves the
+    // object, so translated code has to load the reference at run time.
     virtual void op_const (type t, int64_t value) = 0;
     virtual void op_load  (type t, uint16_t idx) = 0;
     virtual void op_store (type t, uint16_t idx) = 0;
@@ -135,6 +139,8 @@ protected:
     virtual void op_monitorexit() = 0;
 
     method* _method;
+    // Bytecode offset of the instruction that is being translated.
+    uint16_t _insn_pc;
     std::map<uint16_t, std::shared_ptr<basic_block>> _bblock_map;
     std::vector<std::shared_ptr<basic_block>> _bblock_list;
 };
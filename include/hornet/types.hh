@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
 namespace hornet {
 
 //
@@ -18,4 +22,69 @@ enum class type {
     t_void,
 };
 
+// Returns the type of a field descriptor that starts with "ch".
+inline type descriptor_type(char ch)
+{
+    switch (ch) {
+    case 'Z': return type::t_boolean;
+    case 'B': return type::t_byte;
+    case 'C': return type::t_char;
+    case 'S': return type::t_short;
+    case 'I': return type::t_int;
+    case 'J': return type::t_long;
+    case 'F': return type::t_float;
+    case 'D': return type::t_double;
+    case 'L':
+    case '[': return type::t_ref;
+    case 'V': return type::t_void;
+    default:  assert(0);
+    }
+    return type::t_void;
+}
+
+// Returns the field descriptor character of a primitive type "t".
+inline char type_descriptor(type t)
+{
+    switch (t) {
+    case type::t_boolean: return 'Z';
+    case type::t_byte:    return 'B';
+    case type::t_char:    return 'C';
+    case type::t_short:   return 'S';
+    case type::t_int:     return 'I';
+    case type::t_long:    return 'J';
+    case type::t_float:   return 'F';
+    case type::t_double:  return 'D';
+    case type::t_void:    return 'V';
+    case type::t_ref:     break;
+    }
+    assert(0);
+    return 0;
+}
+
+#ifdef CONFIG_COMPRESSED_OOPS
+// References in the heap are 32-bit compressed offsets.
+static constexpr size_t heap_ref_size = sizeof(uint32_t);
+#else
+static constexpr size_t heap_ref_size = sizeof(void*);
+#endif
+
+// Returns the size in bytes of a field of type "t".
+inline size_t type_size(type t)
+{
+    switch (t) {
+    case type::t_boolean:
+    case type::t_byte:    return 1;
+    case type::t_char:
+    case type::t_short:   return 2;
+    case type::t_int:
+    case type::t_float:   return 4;
+    case type::t_long:
+    case type::t_double:  return 8;
+    case type::t_ref:     return heap_ref_size;
+    case type::t_void:    break;
+    }
+    assert(0);
+    return 0;
+}
+
 }
@@ -1,8 +1,14 @@
 #ifndef HORNET_VM_HH
 #define HORNET_VM_HH
 
+#include "hornet/class_dictionary.hh"
+#include "hornet/intern_table.hh"
+#include "hornet/symbol.hh"
+
 #include <unordered_map>
+#include <functional>
 #include <cassert>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
@@ -15,6 +21,10 @@
 
 #include "hornet/types.hh"
 
+struct mps_ap_s;
+struct mps_root_s;
+struct mps_thr_s;
+
 namespace hornet {
 
 class constant_pool;
@@ -22,77 +32,297 @@ struct method;
 struct field;
 struct klass;
 struct string;
+struct monitor;
 class loader;
+class thread;
 
 class jvm {
 public:
     void init();
-    std::shared_ptr<klass> lookup_class(std::string name);
-    void register_class(std::shared_ptr<klass> klass);
+    std::shared_ptr<klass> lookup_class(symbol name);
+    std::shared_ptr<klass> lookup_class(const std::string& name);
+    std::shared_ptr<klass> register_class(std::shared_ptr<klass> klass);
     void invoke(method* method);
-    string* intern_string(std::string str);
+    string** intern_string(const char* utf8, size_t size, uint32_t hash);
+    string** intern_string(const char* utf8, size_t size);
+    void intern_stats();
+    /// Calls "fn" with every registered class. Used by the GC to find the
+    /// class mirrors and static fields.
+    void for_each_class(const std::function<void(klass*)>& fn) const;
+    /// Calls "fn" with the slot of every interned string.
+    void for_each_interned_string(const std::function<void(string**)>& fn) const;
 private:
-    std::mutex _intern_mutex;
-    std::unordered_map<std::string, std::shared_ptr<string>> _intern;
-    std::map<std::string, std::shared_ptr<klass>> _classes;
+    intern_table _intern;
+    class_dictionary _classes;
 };
 
 extern bool bootstrap_done;
+extern bool print_string_table_stats;
 extern std::shared_ptr<klass> java_lang_Class;
 extern std::shared_ptr<klass> java_lang_String;
 extern jvm *_jvm;
 
 using value_t = uint64_t;
 
+#ifdef CONFIG_COMPRESSED_KLASS
+/// All classes indexed by klass::id. Objects refer to their class with a
+/// 32-bit index to this table instead of a full pointer.
+extern klass* klass_table[];
+#endif
+
+/// Object header. Instance fields are laid out inline after the header at
+/// the offsets computed by klass::add().
 struct object {
-    struct object* fwd;
-    struct klass*  klass;
-    std::vector<value_t> _fields;
-    std::mutex _mutex;
+    /// Lock state, identity hash and GC age of the object, or its forwarding
+    /// address while the GC moves it. See vm/object.cc for the encoding.
+    std::atomic<uintptr_t> mark;
+#ifdef CONFIG_COMPRESSED_KLASS
+    uint32_t       _klass;
+#else
+    struct klass*  _klass;
+#endif
 
-    object(struct klass* _klass);
+    object(struct klass* klass_);
     ~object();
 
     object& operator=(const object&) = delete;
     object(const object&) = delete;
 
-    value_t get_field(size_t offset) const {
-        return _fields[offset];
+    struct klass* klass() const {
+#ifdef CONFIG_COMPRESSED_KLASS
+        return klass_table[_klass];
+#else
+        return _klass;
+#endif
+    }
+
+    /// Returns the address the object was moved to, or nullptr if the
+    /// object has not been moved.
+    object* forwardee() const;
+    void forward_to(object* to);
+
+    /// Fills memory with a padding object that the GC steps over. Padding
+    /// can be as small as a single word.
+    static void make_padding(void* addr, size_t size);
+
+    /// Returns the size of a padding object, or zero if the object is not
+    /// padding.
+    size_t padding_size() const;
+
+    /// Returns the identity hash code of the object, generating one on first
+    /// use. The hash is kept in the mark word, or in the monitor if the lock
+    /// is inflated, so it stays the same when the GC moves the object.
+    int32_t identity_hash();
+
+    /// Returns the number of times the GC has moved the object.
+    unsigned age() const;
+    void increment_age();
+
+    /// Marks a java/lang/String instance that the VM created with its
+    /// characters inline, so that the GC sizes it from its length. Strings
+    /// that bytecode constructs are not marked.
+    void set_vm_string();
+    bool is_vm_string() const;
+
+    template<typename T>
+    T get_field(size_t offset) const {
+        return *reinterpret_cast<const T*>(reinterpret_cast<const char*>(this) + offset);
     }
 
-    void set_field(size_t offset, value_t value) {
-        _fields[offset] = value;
+    template<typename T>
+    void set_field(size_t offset, T value) {
+        *reinterpret_cast<T*>(reinterpret_cast<char*>(this) + offset) = value;
     }
 
-    void lock() {
-        _mutex.lock();
+    void lock();
+    void unlock();
+    void wait(int64_t millis);
+    void notify();
+    void notify_all();
+
+private:
+    void lock_slow(uint32_t self);
+    monitor* inflate(uint32_t self);
+};
+
+/// Size of the object header. With a compressed klass word, instance fields
+/// start in the second half of the last header word.
+static constexpr size_t object_header_size = offsetof(object, _klass) + sizeof(object::_klass);
+
+#ifdef CONFIG_COMPRESSED_OOPS
+/// Base address of the GC heap. References stored in object fields and
+/// reference array elements are 32-bit offsets from the base in units of the
+/// object alignment, which limits the heap to 32 GB. The first heap word is
+/// never an object, so a zero offset is the null reference.
+extern char* heap_base;
+
+static constexpr unsigned heap_ref_shift = 3;
+
+/// Largest heap that compressed references can address.
+static constexpr size_t max_compressed_heap_size = size_t(1) << (32 + heap_ref_shift);
+
+using heap_ref = uint32_t;
+
+inline heap_ref encode_heap_ref(object* obj)
+{
+    if (!obj) {
+        return 0;
     }
+    return static_cast<heap_ref>((reinterpret_cast<char*>(obj) - heap_base) >> heap_ref_shift);
+}
 
-    void unlock() {
-        _mutex.unlock();
+inline object* decode_heap_ref(heap_ref ref)
+{
+    if (!ref) {
+        return nullptr;
     }
+    return reinterpret_cast<object*>(heap_base + (static_cast<uintptr_t>(ref) << heap_ref_shift));
+}
+#else
+using heap_ref = object*;
+
+inline heap_ref encode_heap_ref(object* obj)
+{
+    return obj;
+}
+
+inline object* decode_heap_ref(heap_ref ref)
+{
+    return ref;
+}
+#endif
+
+static_assert(sizeof(heap_ref) == heap_ref_size, "heap reference size mismatch");
+
+/// Native methods that execution engines implement directly instead of calling
+/// them through FFI.
+enum class intrinsic : uint8_t {
+    none,
+    object_hash_code,
+    system_identity_hash_code,
 };
 
 using method_list_type = std::vector<std::shared_ptr<method>>;
 using field_list_type = std::vector<std::shared_ptr<field>>;
 
+/// Interface method table of a class for one interface the class
+/// implements. The methods are in the order of the interface's
+/// itable indices.
+struct itable {
+    struct klass* iface;
+    std::vector<method*> methods;
+};
+
+/// Constant pool entries that have been resolved to classes, fields, methods
+/// and interned string slots, indexed by constant pool index. An entry is filled in at most
+/// once and never changes after that, so reading it needs no locking.
+class cp_cache {
+public:
+    explicit cp_cache(uint16_t size)
+        : _entries(new std::atomic<void*>[size])
+    {
+        for (uint16_t i = 0; i < size; i++) {
+            _entries[i] = nullptr;
+        }
+    }
+
+    cp_cache& operator=(const cp_cache&) = delete;
+    cp_cache(const cp_cache&) = delete;
+
+    template<typename T>
+    T* get(uint16_t idx) const {
+        return static_cast<T*>(_entries[idx].load(std::memory_order_acquire));
+    }
+
+    /// Fills in an entry unless another thread did so first, and returns
+    /// the entry.
+    template<typename T>
+    T* set(uint16_t idx, T* value) {
+        void* expected = nullptr;
+        if (_entries[idx].compare_exchange_strong(expected, value, std::memory_order_acq_rel)) {
+            return value;
+        }
+        return static_cast<T*>(expected);
+    }
+
+private:
+    std::unique_ptr<std::atomic<void*>[]> _entries;
+};
+
+/// How the GC finds the size of an instance of a class and the references in
+/// it.
+enum class layout_kind : uint8_t {
+    /// Objects of klass::instance_size bytes with references at the slots
+    /// in klass::oop_map.
+    instance,
+    /// Arrays of references.
+    object_array,
+    /// Arrays of primitive values, which are skipped without being scanned.
+    primitive_array,
+};
+
+/// Number of superclasses that fit in the primary supers display of a class.
+static constexpr uint32_t primary_super_limit = 8;
+
+/// Number of bytes of padding around @Contended fields. This is two cache
+/// lines because adjacent-line prefetchers fetch cache lines in pairs.
+static constexpr size_t contended_padding = 128;
+
 enum class klass_state {
     loaded,
+    initializing,
     initialized,
 };
 
 struct klass {
     /// The java/lang/Class object representation of this class.
     struct object* object;
-    std::string   name;
+    symbol        name;
     klass*        super;
     uint16_t      access_flags;
-    klass_state   state = klass_state::loaded;
-    uint32_t      nr_fields;
+    std::atomic<klass_state> state{klass_state::loaded};
+    /// The thread that runs the class initializer while the class is in
+    /// klass_state::initializing.
+    thread*       init_thread;
+#ifdef CONFIG_COMPRESSED_KLASS
+    /// Index of this class in klass_table.
+    uint32_t      id;
+#endif
+    /// Size of an instance of this class in bytes, including the object
+    /// header and the fields of all superclasses.
+    uint32_t      instance_size;
     std::vector<value_t> static_values;
-    std::vector<std::shared_ptr<klass>> interfaces;
-
-    klass(const std::string& name_, loader* loader = nullptr, std::shared_ptr<constant_pool> const_pool = nullptr);
+    std::vector<klass*> interfaces;
+    /// Virtual method table, indexed by method::vtable_index. Built when the
+    /// class is linked and shared by all execution engines.
+    std::vector<method*> vtable;
+    /// Interface method tables for all the interfaces this class implements,
+    /// directly or through superclasses and superinterfaces.
+    std::vector<itable> itables;
+    /// Number of superclasses of this class. The depth of an interface or an
+    /// array class is primary_super_limit so that it is always looked up
+    /// from secondary supers.
+    uint32_t      super_depth;
+    /// Superclasses indexed by depth, including the class itself. A subtype
+    /// check against a class that fits the display is a single compare.
+    klass*        primary_supers[primary_super_limit];
+    /// Interfaces, and superclasses that do not fit the primary supers
+    /// display, including the class itself.
+    std::vector<klass*> secondary_supers;
+    /// Last secondary super that a subtype check found.
+    std::atomic<klass*> secondary_super_cache;
+    /// True if the class is annotated with @Contended, which pads the
+    /// instance fields it declares as one block.
+    bool          contended;
+    layout_kind   layout;
+    /// Bitmap of the reference slots in an instance, including the fields of
+    /// superclasses. Bit n is set if there is a reference at byte offset
+    /// n * heap_ref_size.
+    std::vector<uint64_t> oop_map;
+    /// Bitmap of the static_values slots that hold references.
+    std::vector<uint64_t> static_oop_map;
+
+    klass(symbol name_, loader* loader = nullptr, std::shared_ptr<constant_pool> const_pool = nullptr);
     virtual ~klass();
 
     klass& operator=(const klass&) = delete;
@@ -102,9 +332,20 @@ struct klass {
     void link();
     bool verify();
 
-    void add(std::shared_ptr<klass> iface);
+    /// Returns the class of arrays whose elements are of this class.
+    klass* array_class();
+
+    /// Returns true if the class initializer has run to completion. Execution
+    /// engines use this to drop class initialization barriers from code that
+    /// refers to the class.
+    bool is_initialized() const {
+        return state.load(std::memory_order_acquire) == klass_state::initialized;
+    }
+
+    void add(klass* iface);
     void add(std::shared_ptr<method> method);
     void add(std::shared_ptr<field> field);
+    void layout_fields();
 
     virtual bool is_primitive() const {
         return false;
@@ -118,19 +359,26 @@ struct klass {
         return false;
     }
 
+    bool is_array() const {
+        return layout == layout_kind::object_array || layout == layout_kind::primitive_array;
+    }
+
+    /// Returns the size of a value of this type in an array or a field.
     virtual size_t size() const {
-        return sizeof(void*);
+        return heap_ref_size;
     }
 
     std::shared_ptr<constant_pool> const_pool() const {
         return _const_pool;
     }
 
-    /// Returns the number of fields for an object instantiated from this class.
-    ///
-    /// Note! The number of fields returned includes fields from this class as
-    /// well as all superclasses.
-    uint32_t nr_object_fields() const;
+    /// Returns true if instances of this class are also instances of "k".
+    bool is_subtype_of(klass* k) {
+        if (k->super_depth < primary_super_limit) {
+            return primary_supers[k->super_depth] == k;
+        }
+        return is_secondary_subtype_of(k);
+    }
 
     bool is_subclass_of(klass* klass) {
         auto* super = this;
@@ -143,24 +391,43 @@ struct klass {
         return false;
     }
 
-    std::shared_ptr<klass> load_class(std::string name);
+    bool is_interface() const {
+        return access_flags & JVM_ACC_INTERFACE;
+    }
+
+    /// Returns the method that an interface call to "desc" invokes on
+    /// instances of this class.
+    method* itable_method(method* desc);
+
+    std::shared_ptr<klass> load_class(const std::string& name);
 
     /// Lookup a method from this class only.
-    std::shared_ptr<method> lookup_method_this(std::string name, std::string desciptor);
+    std::shared_ptr<method> lookup_method_this(symbol name, symbol descriptor);
+    std::shared_ptr<method> lookup_method_this(const std::string& name, const std::string& descriptor);
     /// Lookup a method from this class or any of the superclasses.
-    std::shared_ptr<method> lookup_method(std::string name, std::string desciptor);
-    std::shared_ptr<field> lookup_field(std::string name, std::string desciptor);
+    std::shared_ptr<method> lookup_method(symbol name, symbol descriptor);
+    std::shared_ptr<method> lookup_method(const std::string& name, const std::string& descriptor);
+    std::shared_ptr<field> lookup_field(symbol name, symbol descriptor);
 
-    std::shared_ptr<klass>  resolve_class (uint16_t idx);
-    std::shared_ptr<field>  resolve_field (uint16_t idx);
-    std::shared_ptr<method> resolve_method(uint16_t idx);
-    std::shared_ptr<method> resolve_interface_method(uint16_t idx);
+    klass*  resolve_class (uint16_t idx);
+    field*  resolve_field (uint16_t idx);
+    method* resolve_method(uint16_t idx);
+    method* resolve_interface_method(uint16_t idx);
+    string** resolve_string(uint16_t idx);
 
 private:
+    void link_supers();
+    void link_vtable();
+    void link_itables();
+    void link_oop_map();
+    bool is_secondary_subtype_of(klass* k);
+
     std::shared_ptr<constant_pool> _const_pool;
+    cp_cache _cp_cache;
     method_list_type _methods;
     field_list_type _fields;
     loader* _loader;
+    std::atomic<klass*> _array_class;
 };
 
 template<typename T>
@@ -168,7 +435,7 @@ class primitive_klass : public klass {
     type _type;
 public:
     primitive_klass(const std::string& name, type type_)
-        : klass{name}
+        : klass{intern(name)}
         , _type{type_}
     { }
 
@@ -190,7 +457,7 @@ public:
 
 struct void_klass : public klass {
     void_klass(const std::string& name)
-        : klass(name)
+        : klass(intern(name))
     { }
 
     ~void_klass() {
@@ -216,30 +483,45 @@ struct void_klass : public klass {
 class array_klass : public klass {
 public:
     array_klass(const std::string& name, klass* elem_type)
-        : klass(name)
+        : klass(intern(name))
+        , elem_size(elem_type->size())
         , _elem_type(elem_type)
-    { }
+    {
+        layout = elem_type->is_primitive() ? layout_kind::primitive_array : layout_kind::object_array;
+    }
 
     ~array_klass() {
     }
 
-    virtual size_t size() const override {
-        return _elem_type->size();
+    klass* elem_type() const {
+        return _elem_type;
     }
 
+    /// Size of an element in bytes.
+    const uint32_t elem_size;
+
 private:
     klass* _elem_type;
 };
 
 struct field {
     struct klass* klass;
-    std::string   name;
-    std::string   descriptor;
+    symbol        name;
+    symbol        descriptor;
+    /// Byte offset of the field value from the start of the object for
+    /// instance fields, or index to klass::static_values for static fields.
     uint32_t      offset;
     uint16_t      access_flags;
+    enum type     type;
+    /// True if the field is annotated with @Contended. Fields in the same
+    /// named group share a padded block, and ungrouped fields get a block
+    /// of their own.
+    bool          contended;
+    symbol        contended_group;
 
     field(struct klass* klass_)
         : klass(klass_)
+        , contended(false)
     { }
 
     ~field() {
@@ -252,28 +534,57 @@ struct field {
         return access_flags & JVM_ACC_STATIC;
     }
 
-    bool matches(const std::string& n, const std::string& d) const {
+    size_t size() const {
+        return type_size(type);
+    }
+
+    bool matches(symbol n, symbol d) const {
         return name == n && descriptor == d;
     }
 };
 
+/// Reference slots of an interpreter frame at a GC point. Bit n is set if
+/// local variable n holds a reference, and bit max_locals + n if operand
+/// stack slot n does.
+using gc_map = std::vector<uint64_t>;
+
 struct method {
     // Method lifecycle is tied to the class it belongs to. Use a pointer to
     // klass instead of a smart pointer to break the cyclic dependency during
     // destruction.
     struct klass* klass;
     uint16_t    access_flags;
-    std::string name;
-    std::string descriptor;
-    struct klass* return_type;
-    std::vector<struct klass*> arg_types;
+    symbol      name;
+    symbol      descriptor;
+    type        return_type;
+    std::vector<type> arg_types;
     uint16_t    args_count;
+    /// Number of local variable slots taken by the arguments. Long and
+    /// double arguments take two slots.
+    uint16_t    args_size;
+    uint16_t    max_stack;
     uint16_t    max_locals;
     char*       code;
     uint32_t    code_length;
     std::vector<uint8_t> trampoline;
-
-    method() {
+    /// GC maps of the translated code, keyed by the frame::pc that the
+    /// interpreter records at each GC point.
+    std::unordered_map<uint32_t, gc_map> gc_maps;
+    /// Index of this method in the vtable of its class and subclasses, or -1
+    /// if the method is not dispatched virtually.
+    int32_t     vtable_index;
+    /// Index of this method in the itables of its interface, or -1 if the
+    /// method is not declared in an interface.
+    int32_t     itable_index;
+    enum intrinsic intrinsic;
+
+    method()
+        : max_stack(0)
+        , max_locals(0)
+        , vtable_index(-1)
+        , itable_index(-1)
+        , intrinsic(intrinsic::none)
+    {
     }
 
     ~method() {
@@ -284,7 +595,7 @@ struct method {
     method(const method&) = delete;
 
     std::string full_name() const {
-        return klass->name + "::" + name + descriptor;
+        return klass->name.str() + "::" + name.str() + descriptor.str();
     }
 
     bool is_init() const {
@@ -295,26 +606,34 @@ struct method {
         return access_flags & JVM_ACC_NATIVE;
     }
 
-    bool matches(const std::string& n, const std::string d) const
+    bool is_abstract() const {
+        return access_flags & JVM_ACC_ABSTRACT;
+    }
+
+    bool is_virtual() const {
+        return !(access_flags & (JVM_ACC_STATIC | JVM_ACC_PRIVATE)) && !is_init();
+    }
+
+    bool matches(symbol n, symbol d) const
     {
        return name == n && descriptor == d;
     }
 
     std::string jni_name() const {
-       auto result = klass->name;
+       auto result = klass->name.str();
        for (size_t i = 0; i < result.size(); i++) {
            if (result[i] == '/') {
                result[i] = '_';
            }
        }
-       return "Java_" + result + "_" + name;
+       return "Java_" + result + "_" + name.str();
     }
 };
 
 struct array {
     struct object object;
     uint32_t length;
-    char data[];
+    alignas(uint64_t) char data[];
 
     array(klass* klass, uint32_t length)
         : object(klass)
@@ -340,23 +659,91 @@ struct array {
     }
 };
 
+enum class string_coder : uint8_t {
+    latin1,
+    utf16,
+};
+
+/// Java string created by the VM. It is a java/lang/String instance whose mark
+/// word has object::is_vm_string() set. The instance fields of java/lang/String
+/// come right after the header, followed by the hash, length and coder that
+/// the VM keeps for itself at payload_offset. The characters are stored
+/// inline after them, one byte each if they all fit in Latin-1 and as UTF-16
+/// code units otherwise. Bytecode that accesses the fields of java/lang/String
+/// therefore never sees the characters.
 struct string {
+    struct payload {
+        /// String.hashCode() of the characters, or zero if not computed yet.
+        std::atomic<int32_t> hash;
+        uint32_t length;
+        string_coder coder;
+        alignas(uint16_t) char data[];
+    };
+
     struct object object;
-    const char* data;
 
-    string(const char* data_)
+    /// Offset of the payload, which is the instance size of java/lang/String
+    /// rounded up to the payload alignment. Set by init().
+    static size_t payload_offset;
+
+    string(uint32_t length_, string_coder coder_)
         : object(java_lang_String.get())
-        , data(data_)
-    { assert(java_lang_String.get() != nullptr); }
+    {
+        object.set_vm_string();
+        auto* p = vm_payload();
+        p->hash.store(0, std::memory_order_relaxed);
+        p->length = length_;
+        p->coder = coder_;
+    }
 
     ~string()
     { }
 
     string& operator=(const string&) = delete;
     string(const string&) = delete;
+
+    payload* vm_payload() {
+        return reinterpret_cast<payload*>(reinterpret_cast<char*>(this) + payload_offset);
+    }
+
+    const payload* vm_payload() const {
+        return reinterpret_cast<const payload*>(reinterpret_cast<const char*>(this) + payload_offset);
+    }
+
+    uint32_t length() const {
+        return vm_payload()->length;
+    }
+
+    string_coder coder() const {
+        return vm_payload()->coder;
+    }
+
+    uint16_t char_at(size_t idx) const {
+        auto* p = vm_payload();
+        if (p->coder == string_coder::latin1) {
+            return static_cast<uint8_t>(p->data[idx]);
+        }
+        return reinterpret_cast<const uint16_t*>(p->data)[idx];
+    }
+
+    int32_t hash_code();
+
+    /// Returns the characters encoded as modified UTF-8.
+    std::string to_utf8() const;
+
+    /// Computes payload_offset once java/lang/String has been loaded.
+    static void init();
+
+    /// Returns the number of bytes a string needs in the heap.
+    static size_t size(uint32_t length, string_coder coder);
+
+    /// Returns the number of UTF-16 code units in modified UTF-8 input and
+    /// the narrowest coder that can hold them.
+    static uint32_t utf8_length(const char* utf8, size_t size, string_coder& coder);
+    void decode_utf8(const char* utf8, size_t size);
 };
 
-inline bool is_array_type_name(std::string name) {
+inline bool is_array_type_name(const std::string& name) {
     return !name.empty() && name[0] == '[';
 }
 
@@ -366,10 +753,42 @@ inline bool is_array_type_name(std::string name) {
 
 void prim_pre_init();
 void prim_post_init();
+
+/// Generation chain of the GC. Objects are allocated in the nursery and
+/// every collection that a generation survives promotes it to the next one.
+/// Each generation older than the nursery is gc_generation_growth times the
+/// size of the previous one. The mortalities are the expected fraction of a
+/// generation that dies in a collection, which MPS uses to pace collections.
+extern size_t gc_nursery_size;
+extern unsigned gc_generations;
+extern double gc_nursery_mortality;
+extern double gc_mature_mortality;
+constexpr unsigned gc_generation_growth = 4;
+constexpr unsigned gc_max_generations = 8;
+extern bool print_gc_stats;
+
+/// Heap size. The heap starts out with gc_initial_heap_size bytes of address
+/// space and grows until gc_max_heap_size bytes are in use. A maximum of zero
+/// picks a quarter of physical memory. With gc_large_pages, the heap is
+/// backed by transparent huge pages. Large pages and compressed references
+/// need the whole heap reserved up front, so the heap starts at its maximum.
+extern size_t gc_initial_heap_size;
+extern size_t gc_max_heap_size;
+extern bool gc_large_pages;
+
 void gc_init();
+void gc_stats();
+void out_of_memory();
+mps_ap_s* gc_create_alloc_point();
+void gc_destroy_alloc_point(mps_ap_s* ap);
+mps_thr_s* gc_register_thread();
+void gc_deregister_thread(mps_thr_s* thr);
+mps_root_s* gc_create_thread_root(thread* thread);
+void gc_destroy_thread_root(mps_root_s* root);
 
 object* gc_new_object(klass* klass);
-array* gc_new_object_array(klass* klass, size_t length);
+array* gc_new_object_array(klass* array_klass, size_t length);
+string* gc_new_string(const char* utf8, size_t size);
 
 template<typename T>
 inline
@@ -21,6 +21,32 @@ class_file::~class_file()
 {
 }
 
+// Returns true if the attribute has a @Contended annotation and sets group to
+// the contention group it names, if any.
+static bool is_contended(const attr_info& attr, const constant_pool& constant_pool, symbol& group)
+{
+    if (attr.type != attr_type::runtime_visible_annotations) {
+        return false;
+    }
+    auto& annotations = static_cast<const annotations_attr&>(attr).annotations;
+    for (auto&& annotation : annotations) {
+        auto& type = annotation.type.str();
+        if (type != "Lsun/misc/Contended;" && type != "Ljdk/internal/vm/annotation/Contended;") {
+            continue;
+        }
+        for (auto&& element : annotation.elements) {
+            if (element.name.str() == "value" && element.tag == 's') {
+                auto& value = constant_pool.get_utf8(element.const_value_index).utf8_value;
+                if (value.size() > 0) {
+                    group = value;
+                }
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
 std::shared_ptr<klass> class_file::parse()
 {
     if (!_size)
@@ -50,9 +76,17 @@ std::shared_ptr<klass> class_file::parse()
 
     auto& klass_name = const_pool->get_utf8(klassref.name_index);
 
-    auto klass = std::make_shared<hornet::klass>(klass_name.bytes, hornet::system_loader(), const_pool);
+    auto klass = std::make_shared<hornet::klass>(klass_name.utf8_value, hornet::system_loader(), const_pool);
 
-    hornet::_jvm->register_class(klass);
+    if (super_class) {
+        klass->super = klass->resolve_class(super_class);
+        if (!klass->super) {
+            return nullptr;
+        }
+        klass->instance_size = klass->super->instance_size;
+    } else {
+        klass->super = nullptr;
+    }
 
     auto interfaces_count = read_u2();
 
@@ -60,6 +94,9 @@ std::shared_ptr<klass> class_file::parse()
         auto idx = read_u2();
 
         auto iface = klass->resolve_class(idx);
+        if (!iface) {
+            return nullptr;
+        }
 
         klass->add(iface);
     }
@@ -83,21 +120,20 @@ std::shared_ptr<klass> class_file::parse()
     auto attr_count = read_u2();
 
     for (auto i = 0; i < attr_count; i++) {
-        read_attr_info(*const_pool);
+        auto attr = read_attr_info(*const_pool);
+        symbol group;
+        if (is_contended(*attr, *const_pool, group)) {
+            klass->contended = true;
+        }
     }
 
     klass->access_flags = access_flags;
 
-    if (super_class) {
-        auto super = klass->resolve_class(super_class);
-        klass->super = super.get();
-    } else {
-        klass->super = nullptr;
-    }
+    klass->layout_fields();
 
     klass->link();
 
-    return klass;
+    return hornet::_jvm->register_class(klass);
 }
 
 std::shared_ptr<constant_pool> class_file::read_constant_pool()
@@ -254,14 +290,11 @@ std::shared_ptr<cp_info> class_file::read_const_utf8()
 {
     auto length = read_u2();
 
-    auto bytes = new char[length + 1];
-
-    for (auto i = 0; i < length; i++)
-        bytes[i] = read_u1();
+    std::string bytes(_data + _offset, length);
 
-    bytes[length] = '\0';
+    _offset += length;
 
-    return cp_info::make_utf8_info(bytes);
+    return cp_info::make_utf8_info(intern(bytes));
 }
 
 void class_file::read_const_method_handle()
@@ -294,73 +327,56 @@ std::shared_ptr<field> class_file::read_field_info(klass* klass, constant_pool &
 
     auto f = std::make_shared<field>(klass);
 
-    f->name         = cp_name.bytes;
-    f->descriptor   = cp_descriptor.bytes;
+    f->name         = cp_name.utf8_value;
+    f->descriptor   = cp_descriptor.utf8_value;
     f->access_flags = access_flags;
+    f->type         = descriptor_type(f->descriptor[0]);
 
     auto attr_count = read_u2();
 
     for (auto i = 0; i < attr_count; i++) {
         auto attr = read_attr_info(constant_pool);
+        if (is_contended(*attr, constant_pool, f->contended_group)) {
+            f->contended = true;
+        }
     }
 
     return f;
 }
 
-static std::shared_ptr<klass> parse_type(klass* klass, std::string descriptor, int& pos)
+// Advances "pos" past the field descriptor that starts there.
+static void skip_field_descriptor(const std::string& descriptor, int& pos)
 {
-    auto ch = descriptor[pos++];
-    switch (ch) {
-    case 'B':
-    case 'C':
-    case 'D':
-    case 'F':
-    case 'I':
-    case 'J':
-    case 'S':
-    case 'Z':
-    case 'V': {
-        return prim_sig_to_klass(ch);
+    while (descriptor[pos] == '[') {
+        pos++;
     }
-    case 'L': {
-        auto start = pos;
+    if (descriptor[pos++] == 'L') {
         while (descriptor[pos++] != ';')
             ;;
-        auto len = pos-start-1;
-        assert(len > 0);
-        auto name = descriptor.substr(start, len);
-        return klass->load_class(name);
-    }
-    case '[': {
-        auto elem_type = parse_type(klass, descriptor, pos);
-        if (!elem_type) {
-            return nullptr;
-        }
-        std::string class_name = "[" + elem_type->name;
-        return klass->load_class(class_name);
     }
-    default:
-        fprintf(stderr, "%s '%c'\n", descriptor.c_str(), ch);
-        assert(0);
-        break;
-    }
-    return nullptr;
 }
 
+// Classes named in a method descriptor are loaded only when a constant pool
+// entry that refers to them is resolved, so that classes whose methods refer
+// to each other, or to the class being loaded, can be loaded at all.
 static void parse_method_descriptor(std::shared_ptr<method> m)
 {
     int pos = 0;
 
-    assert(m->descriptor[pos++] == '(');
+    auto& descriptor = m->descriptor.str();
 
-    while (m->descriptor[pos] != ')') {
-        auto arg_type = parse_type(m->klass, m->descriptor, pos);
-        m->arg_types.emplace_back(arg_type.get());
+    assert(descriptor[pos++] == '(');
+
+    m->args_size = 0;
+    while (descriptor[pos] != ')') {
+        auto arg_type = descriptor_type(descriptor[pos]);
+        m->args_size += (arg_type == type::t_long || arg_type == type::t_double) ? 2 : 1;
+        m->arg_types.push_back(arg_type);
+        skip_field_descriptor(descriptor, pos);
     }
     m->args_count = m->arg_types.size();
 
-    auto return_type = parse_type(m->klass, m->descriptor, ++pos);
-    m->return_type = return_type.get();
+    m->return_type = descriptor_type(descriptor[++pos]);
 }
 
 std::shared_ptr<method> class_file::read_method_info(klass* klass, constant_pool &constant_pool)
@@ -381,8 +397,8 @@ std::shared_ptr<method> class_file::read_method_info(klass* klass, constant_pool
 
     m->klass        = klass;
     m->access_flags = access_flags;
-    m->name         = cp_name.bytes;
-    m->descriptor   = cp_descriptor.bytes;
+    m->name         = cp_name.utf8_value;
+    m->descriptor   = cp_descriptor.utf8_value;
     m->code         = nullptr;
     m->code_length  = 0;
 
@@ -394,6 +410,7 @@ std::shared_ptr<method> class_file::read_method_info(klass* klass, constant_pool
         switch (attr->type) {
         case attr_type::code: {
             code_attr* c = static_cast<code_attr*>(attr.get());
+            m->max_stack   = c->max_stack;
             m->max_locals  = c->max_locals;
             m->code        = c->code;
             m->code_length = c->code_length;
@@ -417,9 +434,12 @@ class_file::read_attr_info(constant_pool& constant_pool)
 
     auto& cp_name = constant_pool.get_utf8(attribute_name_index);
 
-    if (!strcmp(cp_name.bytes, "Code")) {
+    if (cp_name.utf8_value.str() == "Code") {
         return read_code_attribute(constant_pool);
     }
+    if (cp_name.utf8_value.str() == "RuntimeVisibleAnnotations") {
+        return read_annotations_attribute(constant_pool);
+    }
 
     for (uint32_t i = 0; i < attribute_length; i++)
         read_u1();
@@ -431,7 +451,7 @@ std::unique_ptr<code_attr>
 class_file::read_code_attribute(constant_pool& constant_pool)
 {
     auto* attr = new code_attr();
-    /*auto max_stack = */read_u2();
+    attr->max_stack = read_u2();
     attr->max_locals = read_u2();
     attr->code_length = read_u4();
     attr->code = new char[attr->code_length];
@@ -451,6 +471,73 @@ class_file::read_code_attribute(constant_pool& constant_pool)
     return std::unique_ptr<code_attr>(attr);
 }
 
+std::unique_ptr<annotations_attr>
+class_file::read_annotations_attribute(constant_pool& constant_pool)
+{
+    auto* attr = new annotations_attr();
+    auto num_annotations = read_u2();
+    for (uint16_t i = 0; i < num_annotations; i++) {
+        attr->annotations.push_back(read_annotation(constant_pool));
+    }
+    return std::unique_ptr<annotations_attr>(attr);
+}
+
+annotation class_file::read_annotation(constant_pool& constant_pool)
+{
+    annotation result;
+    auto type_index = read_u2();
+    result.type = constant_pool.get_utf8(type_index).utf8_value;
+    auto num_element_value_pairs = read_u2();
+    for (uint16_t i = 0; i < num_element_value_pairs; i++) {
+        annotation_element element;
+        auto element_name_index = read_u2();
+        element.name = constant_pool.get_utf8(element_name_index).utf8_value;
+        element.const_value_index = read_element_value(constant_pool, element.tag);
+        result.elements.push_back(element);
+    }
+    return result;
+}
+
+// Returns the constant pool index of a constant element value. Other
+// element values are skipped.
+uint16_t class_file::read_element_value(constant_pool& constant_pool, char& tag)
+{
+    tag = read_u1();
+    switch (tag) {
+    case 'B':
+    case 'C':
+    case 'D':
+    case 'F':
+    case 'I':
+    case 'J':
+    case 'S':
+    case 'Z':
+    case 's':
+        return read_u2();
+    case 'e':
+        /*auto type_name_index = */read_u2();
+        /*auto const_name_index = */read_u2();
+        break;
+    case 'c':
+        /*auto class_info_index = */read_u2();
+        break;
+    case '@':
+        read_annotation(constant_pool);
+        break;
+    case '[': {
+        auto num_values = read_u2();
+        for (uint16_t i = 0; i < num_values; i++) {
+            char value_tag;
+            read_element_value(constant_pool, value_tag);
+        }
+        break;
+    }
+    default:
+        assert(0);
+    }
+    return 0;
+}
+
 uint8_t class_file::read_u1()
 {
     return _data[_offset++];
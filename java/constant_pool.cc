@@ -89,13 +89,13 @@ const cp_info& constant_pool::get_utf8(uint16_t idx) const
     return get_ty<cp_info, cp_tag::const_utf8>(idx);
 }
 
-string *constant_pool::get_string(uint16_t idx) const
+string **constant_pool::get_string(uint16_t idx) const
 {
     auto& entry = get_ty<cp_info, cp_tag::const_string>(idx);
 
     auto& utf8 = get_utf8(entry.string_index);
 
-    return hornet::_jvm->intern_string(std::string(utf8.bytes));
+    return hornet::_jvm->intern_string(utf8.utf8_value.c_str(), utf8.utf8_value.size());
 }
 
 template<typename Type, cp_tag Tag>
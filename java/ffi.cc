@@ -33,9 +33,9 @@ void* ffi_java_sym(method* m)
     return dlsym(ffi_handle, m->jni_name().c_str());
 }
 
-ffi_type* klass_to_ffi_type(klass* klass)
+ffi_type* type_to_ffi_type(type t)
 {
-    switch (klass->get_type()) {
+    switch (t) {
     case type::t_boolean: return &ffi_type_sint8;
     case type::t_byte:    return &ffi_type_sint8;
     case type::t_char:    return &ffi_type_sint16;
@@ -46,7 +46,7 @@ ffi_type* klass_to_ffi_type(klass* klass)
     case type::t_double:  return &ffi_type_double;
     case type::t_ref:     return &ffi_type_pointer;
     case type::t_void:    return &ffi_type_void;
-    default:              throw std::invalid_argument("invalid class type: " + klass->name);
+    default:              throw std::invalid_argument("invalid type");
     }
 }
 
@@ -0,0 +1,496 @@
+#include "hornet/gc_map.hh"
+
+#include "hornet/java.hh"
+
+#include <classfile_constants.h>
+
+#include <cassert>
+
+namespace hornet {
+
+gc_map_builder::gc_map_builder(method* method)
+    : translator(method)
+    , _falls_through(false)
+{
+}
+
+void gc_map_builder::build()
+{
+    scan();
+
+    frame_state entry;
+    entry.locals.resize(_method->max_locals, slot_kind::unusable);
+    size_t idx = 0;
+    if (!(_method->access_flags & JVM_ACC_STATIC)) {
+        entry.locals[idx++] = slot_kind::ref;
+    }
+    for (auto arg_type : _method->arg_types) {
+        auto kind = kind_of(arg_type);
+        entry.locals[idx++] = kind;
+        if (kind == slot_kind::wide) {
+            idx++;
+        }
+    }
+    assert(idx <= entry.locals.size());
+    _entry_states.emplace(0, std::move(entry));
+
+    _worklist.push_back(lookup(0));
+    while (!_worklist.empty()) {
+        auto bblock = _worklist.back();
+        _worklist.pop_back();
+        translate(bblock);
+        if (_falls_through && bblock->end < _method->code_length) {
+            merge(lookup(bblock->end));
+        }
+    }
+}
+
+const gc_map& gc_map_builder::map_at(uint16_t pc) const
+{
+    auto it = _maps.find(pc);
+    if (it == _maps.end()) {
+        // The GC point is in unreachable code.
+        static const gc_map empty;
+        return empty;
+    }
+    return it->second;
+}
+
+gc_map_builder::slot_kind gc_map_builder::kind_of(type t)
+{
+    switch (t) {
+    case type::t_ref:
+        return slot_kind::ref;
+    case type::t_long:
+    case type::t_double:
+        return slot_kind::wide;
+    case type::t_void:
+        assert(0);
+    default:
+        return slot_kind::value;
+    }
+}
+
+void gc_map_builder::push(slot_kind kind)
+{
+    _state.stack.push_back(kind);
+}
+
+gc_map_builder::slot_kind gc_map_builder::pop()
+{
+    assert(!_state.stack.empty());
+    auto kind = _state.stack.back();
+    _state.stack.pop_back();
+    return kind;
+}
+
+void gc_map_builder::pop(size_t count)
+{
+    assert(_state.stack.size() >= count);
+    _state.stack.resize(_state.stack.size() - count);
+}
+
+void gc_map_builder::invoke(method* target, bool receiver)
+{
+    record();
+    pop(target->args_count + receiver);
+    if (target->return_type != type::t_void) {
+        push(kind_of(target->return_type));
+    }
+}
+
+void gc_map_builder::record()
+{
+    auto nr_locals = _state.locals.size();
+    gc_map map((nr_locals + _state.stack.size() + 63) / 64);
+    for (size_t idx = 0; idx < nr_locals; idx++) {
+        if (_state.locals[idx] == slot_kind::ref) {
+            map[idx / 64] |= uint64_t(1) << (idx % 64);
+        }
+    }
+    for (size_t idx = 0; idx < _state.stack.size(); idx++) {
+        if (_state.stack[idx] == slot_kind::ref) {
+            auto bit = nr_locals + idx;
+            map[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+    }
+    // A basic block is revisited until its entry state settles, so the last
+    // map recorded for an instruction is the final one.
+    _maps[_insn_pc] = std::move(map);
+}
+
+void gc_map_builder::merge(std::shared_ptr<basic_block> bblock)
+{
+    auto it = _entry_states.find(bblock->start);
+    if (it == _entry_states.end()) {
+        _entry_states.emplace(bblock->start, _state);
+        _worklist.push_back(bblock);
+        return;
+    }
+    auto& entry = it->second;
+    assert(entry.stack.size() == _state.stack.size());
+    auto changed = false;
+    auto meet = [&changed](slot_kind& to, slot_kind from) {
+        if (to != from && to != slot_kind::unusable) {
+            to = slot_kind::unusable;
+            changed = true;
+        }
+    };
+    for (size_t idx = 0; idx < entry.locals.size(); idx++) {
+        meet(entry.locals[idx], _state.locals[idx]);
+    }
+    for (size_t idx = 0; idx < entry.stack.size(); idx++) {
+        meet(entry.stack[idx], _state.stack[idx]);
+    }
+    if (changed) {
+        _worklist.push_back(bblock);
+    }
+}
+
+void gc_map_builder::prologue()
+{
+}
+
+void gc_map_builder::epilogue()
+{
+}
+
+void gc_map_builder::begin(std::shared_ptr<basic_block> bblock)
+{
+    _state = _entry_states.at(bblock->start);
+    _falls_through = true;
+}
+
+void gc_map_builder::op_const(type t, int64_t value)
+{
+    push(kind_of(t));
+}
+
+void gc_map_builder::op_load(type t, uint16_t idx)
+{
+    push(kind_of(t));
+}
+
+void gc_map_builder::op_store(type t, uint16_t idx)
+{
+    auto kind = pop();
+    auto& locals = _state.locals;
+    assert(idx < locals.size());
+    locals[idx] = kind;
+    if (kind == slot_kind::wide && idx + 1u < locals.size()) {
+        locals[idx + 1] = slot_kind::unusable;
+    }
+    // The store overwrites the second half of a long or double value.
+    if (idx > 0 && locals[idx - 1] == slot_kind::wide) {
+        locals[idx - 1] = slot_kind::unusable;
+    }
+}
+
+void gc_map_builder::op_arrayload(type t)
+{
+    pop(2);
+    push(kind_of(t));
+}
+
+void gc_map_builder::op_arraystore(type t)
+{
+    pop(3);
+}
+
+void gc_map_builder::op_convert(type from, type to)
+{
+    pop();
+    push(kind_of(to));
+}
+
+void gc_map_builder::op_pop()
+{
+    pop();
+}
+
+void gc_map_builder::op_pop2()
+{
+    if (pop() != slot_kind::wide) {
+        pop();
+    }
+}
+
+void gc_map_builder::op_dup()
+{
+    auto value1 = pop();
+    push(value1);
+    push(value1);
+}
+
+void gc_map_builder::op_dup_x1()
+{
+    auto value1 = pop();
+    auto value2 = pop();
+    push(value1);
+    push(value2);
+    push(value1);
+}
+
+void gc_map_builder::op_dup_x2()
+{
+    auto value1 = pop();
+    auto value2 = pop();
+    if (value2 == slot_kind::wide) {
+        push(value1);
+        push(value2);
+        push(value1);
+        return;
+    }
+    auto value3 = pop();
+    push(value1);
+    push(value3);
+    push(value2);
+    push(value1);
+}
+
+void gc_map_builder::op_dup2()
+{
+    auto value1 = pop();
+    if (value1 == slot_kind::wide) {
+        push(value1);
+        push(value1);
+        return;
+    }
+    auto value2 = pop();
+    push(value2);
+    push(value1);
+    push(value2);
+    push(value1);
+}
+
+void gc_map_builder::op_dup2_x1()
+{
+    auto value1 = pop();
+    auto value2 = pop();
+    if (value1 == slot_kind::wide) {
+        push(value1);
+        push(value2);
+        push(value1);
+        return;
+    }
+    auto value3 = pop();
+    push(value2);
+    push(value1);
+    push(value3);
+    push(value2);
+    push(value1);
+}
+
+void gc_map_builder::op_dup2_x2()
+{
+    auto value1 = pop();
+    auto value2 = pop();
+    if (value1 == slot_kind::wide) {
+        if (value2 == slot_kind::wide) {
+            push(value1);
+            push(value2);
+            push(value1);
+            return;
+        }
+        auto value3 = pop();
+        push(value1);
+        push(value3);
+        push(value2);
+        push(value1);
+        return;
+    }
+    auto value3 = pop();
+    if (value3 == slot_kind::wide) {
+        push(value2);
+        push(value1);
+        push(value3);
+        push(value2);
+        push(value1);
+        return;
+    }
+    auto value4 = pop();
+    push(value2);
+    push(value1);
+    push(value4);
+    push(value3);
+    push(value2);
+    push(value1);
+}
+
+void gc_map_builder::op_swap()
+{
+    auto value1 = pop();
+    auto value2 = pop();
+    push(value1);
+    push(value2);
+}
+
+void gc_map_builder::op_unary(type t, unaryop op)
+{
+    pop();
+    push(kind_of(t));
+}
+
+void gc_map_builder::op_binary(type t, binop op)
+{
+    pop(2);
+    push(kind_of(t));
+}
+
+void gc_map_builder::op_iinc(uint8_t idx, jint value)
+{
+}
+
+void gc_map_builder::op_lcmp()
+{
+    pop(2);
+    push(slot_kind::value);
+}
+
+void gc_map_builder::op_cmp(type t, cmpop op)
+{
+    pop(2);
+    push(slot_kind::value);
+}
+
+void gc_map_builder::op_if(type t, cmpop op, std::shared_ptr<basic_block> target)
+{
+    pop();
+    merge(target);
+}
+
+void gc_map_builder::op_if_cmp(type t, cmpop op, std::shared_ptr<basic_block> target)
+{
+    pop(2);
+    merge(target);
+}
+
+void gc_map_builder::op_goto(std::shared_ptr<basic_block> target)
+{
+    merge(target);
+    _falls_through = false;
+}
+
+void gc_map_builder::op_tableswitch(uint32_t high, uint32_t low, std::shared_ptr<basic_block> def, const std::vector<std::shared_ptr<basic_block>>& table)
+{
+    pop();
+    merge(def);
+    for (auto&& target : table) {
+        merge(target);
+    }
+    _falls_through = false;
+}
+
+void gc_map_builder::op_ret()
+{
+    _falls_through = false;
+}
+
+void gc_map_builder::op_ret_void()
+{
+    _falls_through = false;
+}
+
+void gc_map_builder::op_getstatic(field* field)
+{
+    record();
+    push(kind_of(field->type));
+}
+
+void gc_map_builder::op_putstatic(field* field)
+{
+    record();
+    pop();
+}
+
+void gc_map_builder::op_getfield(field* field)
+{
+    pop();
+    push(kind_of(field->type));
+}
+
+void gc_map_builder::op_putfield(field* field)
+{
+    pop(2);
+}
+
+void gc_map_builder::op_invokevirtual(method* target)
+{
+    invoke(target, true);
+}
+
+void gc_map_builder::op_invokespecial(method* target)
+{
+    invoke(target, true);
+}
+
+void gc_map_builder::op_invokestatic(method* target)
+{
+    invoke(target, false);
+}
+
+void gc_map_builder::op_invokeinterface(method* target)
+{
+    invoke(target, true);
+}
+
+void gc_map_builder::op_new(klass* klass)
+{
+    record();
+    push(slot_kind::ref);
+}
+
+void gc_map_builder::op_newarray(uint8_t atype)
+{
+    record();
+    pop();
+    push(slot_kind::ref);
+}
+
+void gc_map_builder::op_anewarray(klass* klass)
+{
+    record();
+    pop();
+    push(slot_kind::ref);
+}
+
+void gc_map_builder::op_multianewarray(klass* klass, uint8_t dimensions)
+{
+    record();
+    pop(dimensions);
+    push(slot_kind::ref);
+}
+
+void gc_map_builder::op_arraylength()
+{
+    pop();
+    push(slot_kind::value);
+}
+
+void gc_map_builder::op_athrow()
+{
+    pop();
+    _falls_through = false;
+}
+
+void gc_map_builder::op_checkcast(klass* klass)
+{
+}
+
+void gc_map_builder::op_instanceof(klass* klass)
+{
+    pop();
+    push(slot_kind::value);
+}
+
+void gc_map_builder::op_monitorenter()
+{
+    pop();
+}
+
+void gc_map_builder::op_monitorexit()
+{
+    pop();
+}
+
+}
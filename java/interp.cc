@@ -1,13 +1,20 @@
 #include "hornet/java.hh"
 
 #include "hornet/translator.hh"
+#include "hornet/gc_map.hh"
 #include "hornet/ffi.hh"
 #include "hornet/jni.hh"
 #include "hornet/vm.hh"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
+#include <map>
 #include <stack>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <classfile_constants.h>
 #include <ffi.h>
@@ -15,6 +22,23 @@
 
 namespace hornet {
 
+bool overlapping_frames = true;
+
+bool stack_caching = true;
+
+bool direct_threading = true;
+
+bool superinstructions = true;
+
+bool instruction_profile;
+
+// Returns true if trampolines are in direct-threaded format. Profiling
+// always uses the byte format.
+static bool threaded_code()
+{
+    return direct_threading && !instruction_profile;
+}
+
 template<typename T>
 void op_const(frame& frame, T value)
 {
@@ -55,6 +79,30 @@ void op_arraystore(frame& frame)
     arrayref->set<T>(index, value);
 }
 
+// Reference array elements are stored as heap references.
+template<>
+void op_arrayload<object*>(frame& frame)
+{
+    auto index = from_value<jint>(frame.ostack_top());
+    frame.ostack_pop();
+    auto arrayref = from_value<array*>(frame.ostack_top());
+    frame.ostack_pop();
+    auto value = to_value(decode_heap_ref(arrayref->get<heap_ref>(index)));
+    frame.ostack_push(value);
+}
+
+template<>
+void op_arraystore<object*>(frame& frame)
+{
+    auto value = from_value<object*>(frame.ostack_top());
+    frame.ostack_pop();
+    auto index = from_value<jint>(frame.ostack_top());
+    frame.ostack_pop();
+    auto arrayref = from_value<array*>(frame.ostack_top());
+    frame.ostack_pop();
+    arrayref->set<heap_ref>(index, encode_heap_ref(value));
+}
+
 void op_pop(frame& frame)
 {
     frame.ostack_pop();
@@ -161,6 +209,24 @@ void op_binary(frame& frame, binop op)
     frame.ostack_push(to_value<T>(result));
 }
 
+// Variants of op_binary() for stack caching where the top, or the top two,
+// operand stack values are cached in registers.
+template<typename T>
+value_t op_binary_s1(frame& frame, binop op, value_t tos0)
+{
+    auto value1 = from_value<T>(frame.ostack_top());
+    frame.ostack_pop();
+    auto result = eval(op, value1, from_value<T>(tos0));
+    return to_value<T>(result);
+}
+
+template<typename T>
+value_t op_binary_s2(binop op, value_t tos0, value_t tos1)
+{
+    auto result = eval(op, from_value<T>(tos0), from_value<T>(tos1));
+    return to_value<T>(result);
+}
+
 void op_iinc(frame& frame, uint16_t idx, jint value)
 {
     frame.locals[idx] += value;
@@ -275,6 +341,22 @@ void op_shift(frame& frame, shiftop op, jint mask)
     frame.ostack_push(to_value<T>(result));
 }
 
+template<typename T>
+value_t op_shift_s1(frame& frame, shiftop op, jint mask, value_t tos0)
+{
+    auto value1 = from_value<T>(frame.ostack_top());
+    frame.ostack_pop();
+    auto result = eval(op, value1, from_value<jint>(tos0) & mask);
+    return to_value<T>(result);
+}
+
+template<typename T>
+value_t op_shift_s2(shiftop op, jint mask, value_t tos0, value_t tos1)
+{
+    auto result = eval(op, from_value<T>(tos0), from_value<jint>(tos1) & mask);
+    return to_value<T>(result);
+}
+
 template<typename T>
 bool eval(cmpop op, T a, T b)
 {
@@ -290,24 +372,50 @@ bool eval(cmpop op, T a, T b)
 }
 
 template<typename T>
-void op_if(frame& frame, cmpop op, uint16_t offset)
+void op_if(frame& frame, uint32_t& pc, cmpop op, uint32_t offset)
 {
     auto value = from_value<T>(frame.ostack_top());
     frame.ostack_pop();
     if (eval(op, value, static_cast<T>(0))) {
-        frame.pc = offset;
+        pc = offset;
     }
 }
 
 template<typename T>
-void op_if_cmp(frame& frame, cmpop op, uint16_t offset)
+void op_if_cmp(frame& frame, uint32_t& pc, cmpop op, uint32_t offset)
 {
     auto value2 = from_value<T>(frame.ostack_top());
     frame.ostack_pop();
     auto value1 = from_value<T>(frame.ostack_top());
     frame.ostack_pop();
     if (eval(op, value1, value2)) {
-        frame.pc = offset;
+        pc = offset;
+    }
+}
+
+template<typename T>
+void op_if_s1(frame& frame, uint32_t& pc, cmpop op, uint32_t offset, value_t tos0)
+{
+    if (eval(op, from_value<T>(tos0), static_cast<T>(0))) {
+        pc = offset;
+    }
+}
+
+template<typename T>
+void op_if_cmp_s1(frame& frame, uint32_t& pc, cmpop op, uint32_t offset, value_t tos0)
+{
+    auto value1 = from_value<T>(frame.ostack_top());
+    frame.ostack_pop();
+    if (eval(op, value1, from_value<T>(tos0))) {
+        pc = offset;
+    }
+}
+
+template<typename T>
+void op_if_cmp_s2(frame& frame, uint32_t& pc, cmpop op, uint32_t offset, value_t tos0, value_t tos1)
+{
+    if (eval(op, from_value<T>(tos0), from_value<T>(tos1))) {
+        pc = offset;
     }
 }
 
@@ -316,15 +424,15 @@ void op_goto(frame& frame, int16_t offset)
     frame.pc += offset;
 }
 
-void op_tableswitch(frame& frame, int32_t high, int32_t low, uint16_t def, const uint16_t* table)
+void op_tableswitch(frame& frame, uint32_t& pc, int32_t high, int32_t low, uint32_t def, const uint32_t* table)
 {
     auto index = from_value<jint>(frame.ostack_top());
     frame.ostack_pop();
     if (index < low || index > high) {
-        frame.pc = def;
+        pc = def;
     } else {
         auto idx = index - low;
-        frame.pc = table[idx];
+        pc = table[idx];
     }
 }
 
@@ -336,6 +444,11 @@ void op_getstatic(field* field, frame& frame)
     frame.ostack_push(klass->static_values[field->offset]);
 }
 
+void op_getstatic_quick(const value_t* addr, frame& frame)
+{
+    frame.ostack_push(*addr);
+}
+
 void op_putstatic(field* field, frame& frame)
 {
     assert(field != nullptr);
@@ -345,15 +458,56 @@ void op_putstatic(field* field, frame& frame)
     frame.ostack_pop();
 }
 
+void op_putstatic_quick(value_t* addr, frame& frame)
+{
+    *addr = frame.ostack_top();
+    frame.ostack_pop();
+}
+
+// Instance fields are stored in the size of their type, so values are widened
+// and narrowed like array elements when moved to and from the operand stack.
+static value_t load_field(object* objectref, field* field)
+{
+    auto offset = field->offset;
+    switch (field->type) {
+    case type::t_boolean: return to_value(objectref->get_field<jboolean>(offset));
+    case type::t_byte:    return to_value(objectref->get_field<jbyte>(offset));
+    case type::t_char:    return to_value(objectref->get_field<jchar>(offset));
+    case type::t_short:   return to_value(objectref->get_field<jshort>(offset));
+    case type::t_int:     return to_value(objectref->get_field<jint>(offset));
+    case type::t_long:    return to_value(objectref->get_field<jlong>(offset));
+    case type::t_float:   return to_value(objectref->get_field<jfloat>(offset));
+    case type::t_double:  return to_value(objectref->get_field<jdouble>(offset));
+    case type::t_ref:     return to_value(decode_heap_ref(objectref->get_field<heap_ref>(offset)));
+    default:              assert(0);
+    }
+    return 0;
+}
+
+static void store_field(object* objectref, field* field, value_t value)
+{
+    auto offset = field->offset;
+    switch (field->type) {
+    case type::t_boolean: objectref->set_field(offset, from_value<jboolean>(value)); break;
+    case type::t_byte:    objectref->set_field(offset, from_value<jbyte>(value));    break;
+    case type::t_char:    objectref->set_field(offset, from_value<jchar>(value));    break;
+    case type::t_short:   objectref->set_field(offset, from_value<jshort>(value));   break;
+    case type::t_int:     objectref->set_field(offset, from_value<jint>(value));     break;
+    case type::t_long:    objectref->set_field(offset, from_value<jlong>(value));    break;
+    case type::t_float:   objectref->set_field(offset, from_value<jfloat>(value));   break;
+    case type::t_double:  objectref->set_field(offset, from_value<jdouble>(value));  break;
+    case type::t_ref:     objectref->set_field(offset, encode_heap_ref(from_value<object*>(value))); break;
+    default:              assert(0);
+    }
+}
+
 void op_getfield(field* field, frame& frame)
 {
     assert(field != nullptr);
     auto objectref = from_value<object*>(frame.ostack_top());
     frame.ostack_pop();
     assert(objectref != nullptr);
-    objectref->klass->init();
-    auto value = objectref->get_field(field->offset);
-    frame.ostack_push(value);
+    frame.ostack_push(load_field(objectref, field));
 }
 
 void op_putfield(field* field, frame& frame)
@@ -364,59 +518,149 @@ void op_putfield(field* field, frame& frame)
     auto objectref = from_value<object*>(frame.ostack_top());
     frame.ostack_pop();
     assert(objectref != nullptr);
-    objectref->klass->init();
-    objectref->set_field(field->offset, value);
+    store_field(objectref, field, value);
 }
 
-void op_invokevirtual(method* desc, frame& frame)
+// Make a callee frame for invoking "target". The arguments, preceded by the
+// receiver if "receiver" is set, are taken off the top of the caller's operand
+// stack. With overlapping frames, the callee's first local variables alias
+// the arguments in place. Long and double arguments occupy one operand stack
+// slot but two local variable slots, so they have to be copied.
+static frame* make_invoke_frame(thread* thread, method* target, frame& frame, bool receiver)
 {
-    auto thread = hornet::thread::current();
-    auto args_count = desc->args_count+1;
-    auto new_frame = thread->make_frame(args_count);
-    for (int i = 1; i < args_count; i++) {
-        auto arg_idx = args_count - i;
-        new_frame->locals[arg_idx] = frame.ostack_top();
+    auto* args = frame.sp - (target->args_count + receiver);
+    frame.sp = args;
+    if (overlapping_frames && target->args_size == target->args_count) {
+        return thread->make_frame(args, target);
+    }
+    auto new_frame = thread->make_frame(target);
+    auto* locals = new_frame->locals;
+    if (receiver) {
+        *locals++ = *args++;
+    }
+    for (int i = 0; i < target->args_count; i++) {
+        *locals++ = *args++;
+        auto arg_type = target->arg_types[i];
+        if (arg_type == type::t_long || arg_type == type::t_double) {
+            locals++;
+        }
+    }
+    return new_frame;
+}
+
+// A call site inline cache that maps receiver classes to the target methods
+// of an interface call. The cache is embedded in the trampoline after the
+// method descriptor operand of the call instruction. It starts out empty,
+// becomes monomorphic on the first call, and polymorphic as new receiver
+// classes are seen. Once all the entries are taken, the call site is
+// megamorphic and receiver classes that miss the cache are looked up from
+// their itables on every call. Virtual calls need no cache because they are
+// dispatched with a vtable load.
+//
+// Entries are never changed once they are filled in so that readers do not
+// need locking. A writer claims an entry by bumping "nr_claimed" and
+// publishes it by storing the receiver class last.
+struct inline_cache {
+    static constexpr uint32_t nr_entries = 4;
+
+    std::atomic<klass*> klasses[nr_entries];
+    method* targets[nr_entries];
+    std::atomic<uint32_t> nr_claimed;
+
+    inline_cache()
+        : nr_claimed(0)
+    {
+        for (uint32_t i = 0; i < nr_entries; i++) {
+            klasses[i] = nullptr;
+            targets[i] = nullptr;
+        }
+    }
+
+    bool is_megamorphic() const {
+        return nr_claimed.load(std::memory_order_relaxed) >= nr_entries;
+    }
+
+    method* lookup(method* desc, klass* klass) {
+        for (uint32_t i = 0; i < nr_entries; i++) {
+            auto* k = klasses[i].load(std::memory_order_acquire);
+            if (k == klass) {
+                return targets[i];
+            }
+            if (!k) {
+                break;
+            }
+        }
+        auto* target = klass->itable_method(desc);
+        assert(target != nullptr);
+        if (!is_megamorphic()) {
+            auto idx = nr_claimed.fetch_add(1, std::memory_order_relaxed);
+            if (idx < nr_entries) {
+                targets[idx] = target;
+                klasses[idx].store(klass, std::memory_order_release);
+            }
+        }
+        return target;
+    }
+};
+
+// Native methods that are not implemented by the VM are only supported as
+// static methods that are called through FFI.
+static void invoke_intrinsic(method* target, frame& frame)
+{
+    switch (target->intrinsic) {
+    case intrinsic::object_hash_code:
+    case intrinsic::system_identity_hash_code: {
+        auto objectref = from_value<object*>(frame.ostack_top());
         frame.ostack_pop();
+        frame.ostack_push(to_value<jint>(objectref ? objectref->identity_hash() : 0));
+        break;
     }
-    auto objectref = from_value<object*>(frame.ostack_top());
-    frame.ostack_pop();
-    assert(objectref != nullptr);
-    new_frame->locals[0] = to_value(objectref);
-    auto klass = objectref->klass;
-    assert(klass != nullptr);
-    auto target = klass->lookup_method(desc->name, desc->descriptor);
-    assert(target != nullptr);
-    assert(!target->is_native());
-    new_frame->reserve_more(target->max_locals);
-    auto result = hornet::_backend->execute(target.get(), *new_frame);
-    if (target->return_type && !target->return_type->is_void()) {
-        frame.ostack_push(result);
+    default:
+        throw std::runtime_error("native method " + target->full_name() + " is not supported");
     }
-    thread->free_frame(new_frame);
 }
 
-void op_invokespecial(method* target, frame& frame)
+static void invoke_virtual(method* target, frame& frame)
 {
-    assert(!target->is_native());
+    if (target->is_native()) {
+        invoke_intrinsic(target, frame);
+        return;
+    }
     auto thread = hornet::thread::current();
-    auto new_frame = thread->make_frame(target->max_locals+1);
-    auto args_count = target->args_count+1;
-    for (int i = 1; i < args_count; i++) {
-        auto arg_idx = args_count - i;
-        new_frame->locals[arg_idx] = frame.ostack_top();
-        frame.ostack_pop();
+    assert(!target->is_abstract());
+    auto new_frame = make_invoke_frame(thread, target, frame, true);
+    auto result = hornet::_backend->execute(target, *new_frame);
+    thread->free_frame(new_frame);
+    if (target->return_type != type::t_void) {
+        frame.ostack_push(result);
     }
-    auto objectref = from_value<object*>(frame.ostack_top());
-    frame.ostack_pop();
+}
+
+void op_invokevirtual(method* desc, frame& frame)
+{
+    auto objectref = from_value<object*>(frame.ostack_peek(desc->args_count));
     assert(objectref != nullptr);
-    new_frame->locals[0] = to_value(objectref);
-    auto klass = objectref->klass;
+    auto klass = objectref->klass();
     assert(klass != nullptr);
+    // Private methods are not in vtables.
+    auto target = desc->vtable_index < 0 ? desc : klass->vtable[desc->vtable_index];
+    invoke_virtual(target, frame);
+}
+
+void op_invokespecial(method* target, frame& frame)
+{
+    if (target->is_native()) {
+        invoke_intrinsic(target, frame);
+        return;
+    }
+    auto thread = hornet::thread::current();
+    assert(frame.ostack_peek(target->args_count) != 0);
+    auto new_frame = make_invoke_frame(thread, target, frame, true);
     auto result = hornet::_backend->execute(target, *new_frame);
-    if (target->return_type && !target->return_type->is_void()) {
+    thread->free_frame(new_frame);
+    if (target->return_type != type::t_void) {
         frame.ostack_push(result);
     }
-    thread->free_frame(new_frame);
 }
 
 void op_invokestatic_ffi(method* target, frame& frame)
@@ -441,7 +685,7 @@ void op_invokestatic_ffi(method* target, frame& frame)
     values[1] = &target->klass;
 
     for (int i = 0; i < target->args_count; i++) {
-        args[i+2] = klass_to_ffi_type(target->arg_types[i]);
+        args[i+2] = type_to_ffi_type(target->arg_types[i]);
     }
 
     for (int i = 0; i < target->args_count; i++) {
@@ -451,14 +695,14 @@ void op_invokestatic_ffi(method* target, frame& frame)
         values[i+2] = value;
     }
 
-    auto rtype = klass_to_ffi_type(target->return_type);
+    auto rtype = type_to_ffi_type(target->return_type);
 
     if (ffi_prep_cif(&cif, FFI_DEFAULT_ABI, args_count, rtype, args) == FFI_OK) {
         value_t ret;
 
         ffi_call(&cif, reinterpret_cast<void (*)()>(sym), &ret, values);
 
-        assert(target->return_type->is_void());
+        assert(target->return_type == type::t_void);
     } else {
         assert(0);
     }
@@ -467,48 +711,59 @@ void op_invokestatic_ffi(method* target, frame& frame)
 void op_invokestatic_java(method* target, frame& frame)
 {
     auto thread = hornet::thread::current();
-    auto new_frame = thread->make_frame(target->max_locals);
-    for (int i = 0; i < target->args_count; i++) {
-        auto arg_idx = target->args_count - i - 1;
-        new_frame->locals[arg_idx] = frame.ostack_top();
-        frame.ostack_pop();
-    }
+    auto new_frame = make_invoke_frame(thread, target, frame, false);
     auto result = hornet::_backend->execute(target, *new_frame);
-    if (target->return_type && !target->return_type->is_void()) {
+    thread->free_frame(new_frame);
+    if (target->return_type != type::t_void) {
         frame.ostack_push(result);
     }
-    thread->free_frame(new_frame);
 }
 
-void op_invokestatic(method* target, frame& frame)
+void op_invokestatic_quick(method* target, frame& frame)
 {
-    target->klass->init();
-
-    if (target->access_flags & JVM_ACC_NATIVE) {
+    if (target->intrinsic != intrinsic::none) {
+        invoke_intrinsic(target, frame);
+    } else if (target->access_flags & JVM_ACC_NATIVE) {
         op_invokestatic_ffi(target, frame);
     } else {
         op_invokestatic_java(target, frame);
     }
 }
 
-void op_invokeinterface(method* desc, frame& frame)
+void op_invokestatic(method* target, frame& frame)
+{
+    target->klass->init();
+
+    op_invokestatic_quick(target, frame);
+}
+
+void op_invokeinterface(method* desc, inline_cache* cache, frame& frame)
 {
-    op_invokevirtual(desc, frame);
+    auto objectref = from_value<object*>(frame.ostack_peek(desc->args_count));
+    assert(objectref != nullptr);
+    auto klass = objectref->klass();
+    assert(klass != nullptr);
+    invoke_virtual(cache->lookup(desc, klass), frame);
 }
 
-void op_new(klass* klass, frame& frame)
+void op_new_quick(klass* klass, frame& frame)
 {
-    klass->init();
     object* obj = gc_new_object(klass);
     frame.ostack_push(to_value<object*>(obj));
 }
 
+void op_new(klass* klass, frame& frame)
+{
+    klass->init();
+    op_new_quick(klass, frame);
+}
+
 void op_newarray(uint8_t atype, frame& frame)
 {
     auto count = from_value<jint>(frame.ostack_top());
     frame.ostack_pop();
-    auto klass = atype_to_klass(atype);
-    auto* arrayref = gc_new_object_array(klass.get(), count);
+    auto klass = atype_to_klass(atype)->array_class();
+    auto* arrayref = gc_new_object_array(klass, count);
     frame.ostack_push(to_value(arrayref));
 }
 
@@ -516,7 +771,7 @@ void op_anewarray(klass* klass, frame& frame)
 {
     auto count = from_value<jint>(frame.ostack_top());
     frame.ostack_pop();
-    auto* arrayref = gc_new_object_array(klass, count);
+    auto* arrayref = gc_new_object_array(klass->array_class(), count);
     frame.ostack_push(to_value(arrayref));
 }
 
@@ -543,7 +798,7 @@ void op_checkcast(frame& frame, klass* type)
     auto* objectref = from_value<object*>(frame.ostack_top());
 
     if (objectref) {
-        if (!objectref->klass->is_subclass_of(type)) {
+        if (!objectref->klass()->is_subtype_of(type)) {
             // TODO: Throw ClassCastException
             assert(0);
         }
@@ -556,7 +811,7 @@ void op_instanceof(frame& frame, klass* type)
     frame.ostack_pop();
 
     if (objectref) {
-        frame.ostack_push(to_value<jint>(!objectref->klass->is_subclass_of(type)));
+        frame.ostack_push(to_value<jint>(objectref->klass()->is_subtype_of(type)));
     } else {
         frame.ostack_push(to_value<jint>(0));
     }
@@ -579,359 +834,535 @@ void op_monitorexit(frame& frame)
 //
 // Instruction opcodes of the interpreter.
 //
-// This enumeration needs to be in the same order as labels in dispatch_table.
+// The opcode enumeration and the interpreter dispatch table are both generated
+// from this list so that they are always in the same order.
+//
+// The "_sN" instructions are stack-cached variants of hot instructions where N
+// is the number of operand stack values that are cached in registers before
+// the instruction executes. Variants of an instruction need to be kept
+// consecutive and ordered by N.
+//
+#define INTERP_OPCODES(x) \
+    x(iconst)             \
+    x(lconst)             \
+    x(fconst)             \
+    x(dconst)             \
+    x(aconst)             \
+    x(load)               \
+    x(store)              \
+    x(barrayload)         \
+    x(sarrayload)         \
+    x(iarrayload)         \
+    x(larrayload)         \
+    x(carrayload)         \
+    x(farrayload)         \
+    x(darrayload)         \
+    x(aarrayload)         \
+    x(barraystore)        \
+    x(sarraystore)        \
+    x(iarraystore)        \
+    x(larraystore)        \
+    x(carraystore)        \
+    x(farraystore)        \
+    x(darraystore)        \
+    x(aarraystore)        \
+    x(pop)                \
+    x(dup)                \
+    x(dup_x1)             \
+    x(swap)               \
+    x(iadd)               \
+    x(isub)               \
+    x(imul)               \
+    x(idiv)               \
+    x(irem)               \
+    x(ineg)               \
+    x(ishl)               \
+    x(ishr)               \
+    x(iushr)              \
+    x(iand)               \
+    x(ior)                \
+    x(ixor)               \
+    x(ladd)               \
+    x(lsub)               \
+    x(lmul)               \
+    x(ldiv)               \
+    x(lrem)               \
+    x(lneg)               \
+    x(lshl)               \
+    x(lshr)               \
+    x(lushr)              \
+    x(land)               \
+    x(lor)                \
+    x(lxor)               \
+    x(fadd)               \
+    x(fsub)               \
+    x(fmul)               \
+    x(fdiv)               \
+    x(frem)               \
+    x(fneg)               \
+    x(dadd)               \
+    x(dsub)               \
+    x(dmul)               \
+    x(ddiv)               \
+    x(drem)               \
+    x(dneg)               \
+    x(iinc)               \
+    x(i2l)                \
+    x(i2f)                \
+    x(i2d)                \
+    x(l2i)                \
+    x(l2f)                \
+    x(l2d)                \
+    x(f2i)                \
+    x(f2l)                \
+    x(f2d)                \
+    x(d2i)                \
+    x(d2l)                \
+    x(d2f)                \
+    x(i2b)                \
+    x(i2c)                \
+    x(i2s)                \
+    x(lcmp)               \
+    x(fcmpl)              \
+    x(fcmpg)              \
+    x(dcmpl)              \
+    x(dcmpg)              \
+    x(ifeq)               \
+    x(ifne)               \
+    x(iflt)               \
+    x(ifge)               \
+    x(ifgt)               \
+    x(ifle)               \
+    x(if_icmpeq)          \
+    x(if_icmpne)          \
+    x(if_icmplt)          \
+    x(if_icmpge)          \
+    x(if_icmpgt)          \
+    x(if_icmple)          \
+    x(if_acmpeq)          \
+    x(if_acmpne)          \
+    x(goto_)              \
+    x(tableswitch)        \
+    x(ret)                \
+    x(ret_void)           \
+    x(getstatic)          \
+    x(putstatic)          \
+    x(getfield)           \
+    x(putfield)           \
+    x(invokevirtual)      \
+    x(invokespecial)      \
+    x(invokestatic)       \
+    x(invokeinterface)    \
+    x(new_)               \
+    x(newarray)           \
+    x(anewarray)          \
+    x(multianewarray)     \
+    x(arraylength)        \
+    x(athrow)             \
+    x(checkcast)          \
+    x(instanceof)         \
+    x(monitorenter)       \
+    x(monitorexit)        \
+    x(ifnull)             \
+    x(ifnonnull)          \
+    x(profile_block)      \
+    x(getstatic_quick)    \
+    x(putstatic_quick)    \
+    x(invokestatic_quick) \
+    x(new_quick)          \
+    x(flush_s1)           \
+    x(flush_s2)           \
+    x(iconst_s0)          \
+    x(iconst_s1)          \
+    x(iconst_s2)          \
+    x(load_s0)            \
+    x(load_s1)            \
+    x(load_s2)            \
+    x(store_s1)           \
+    x(store_s2)           \
+    x(iadd_s1)            \
+    x(iadd_s2)            \
+    x(isub_s1)            \
+    x(isub_s2)            \
+    x(imul_s1)            \
+    x(imul_s2)            \
+    x(ishl_s1)            \
+    x(ishl_s2)            \
+    x(ishr_s1)            \
+    x(ishr_s2)            \
+    x(iushr_s1)           \
+    x(iushr_s2)           \
+    x(iand_s1)            \
+    x(iand_s2)            \
+    x(ior_s1)             \
+    x(ior_s2)             \
+    x(ixor_s1)            \
+    x(ixor_s2)            \
+    x(ifeq_s1)            \
+    x(ifne_s1)            \
+    x(iflt_s1)            \
+    x(ifge_s1)            \
+    x(ifgt_s1)            \
+    x(ifle_s1)            \
+    x(if_icmpeq_s1)       \
+    x(if_icmpeq_s2)       \
+    x(if_icmpne_s1)       \
+    x(if_icmpne_s2)       \
+    x(if_icmplt_s1)       \
+    x(if_icmplt_s2)       \
+    x(if_icmpge_s1)       \
+    x(if_icmpge_s2)       \
+    x(if_icmpgt_s1)       \
+    x(if_icmpgt_s2)       \
+    x(if_icmple_s1)       \
+    x(if_icmple_s2)
+
+//
+// Superinstructions of the interpreter.
+//
+// A superinstruction executes a sequence of component instructions with one
+// dispatch. It is encoded as the superinstruction opcode followed by the
+// operands of its components, in order. The translator fuses instructions
+// pairwise as they are emitted, which is why every prefix of a sequence that
+// has more than two components must itself be listed before the sequence.
+// Only the last component is allowed to transfer control.
+//
+// The set was chosen from the instruction n-gram profile that is printed with
+// -XX:+PrintInstructionProfile and is retuned by editing this list.
 //
+#define INTERP_SUPERINSTRUCTIONS(x2, x3, x4)                                   \
+    x2(load_iconst_s0,           load_s0,   iconst_s1)                         \
+    x3(load_iconst_if_icmpeq_s0, load_s0,   iconst_s1, if_icmpeq_s2)           \
+    x3(load_iconst_if_icmpne_s0, load_s0,   iconst_s1, if_icmpne_s2)           \
+    x3(load_iconst_if_icmplt_s0, load_s0,   iconst_s1, if_icmplt_s2)           \
+    x3(load_iconst_if_icmpge_s0, load_s0,   iconst_s1, if_icmpge_s2)           \
+    x3(load_iconst_if_icmpgt_s0, load_s0,   iconst_s1, if_icmpgt_s2)           \
+    x3(load_iconst_if_icmple_s0, load_s0,   iconst_s1, if_icmple_s2)           \
+    x2(load_flush_s0,            load_s0,   flush_s1)                          \
+    x3(load_getfield_s0,         load_s0,   flush_s1,  getfield)               \
+    x3(load_invokevirtual_s0,    load_s0,   flush_s1,  invokevirtual)          \
+    x2(load_load_s0,             load_s0,   load_s1)                           \
+    x3(load_load_iadd_s0,        load_s0,   load_s1,   iadd_s2)                \
+    x4(load_load_iadd_store_s0,  load_s0,   load_s1,   iadd_s2,  store_s1)     \
+    x2(iconst_iadd_s0,           iconst_s0, iadd_s1)                           \
+    x2(iinc_goto,                iinc,      goto_)                             \
+    x2(load_iconst,              load,      iconst)                            \
+    x3(load_iconst_if_icmpeq,    load,      iconst,    if_icmpeq)              \
+    x3(load_iconst_if_icmpne,    load,      iconst,    if_icmpne)              \
+    x3(load_iconst_if_icmplt,    load,      iconst,    if_icmplt)              \
+    x3(load_iconst_if_icmpge,    load,      iconst,    if_icmpge)              \
+    x3(load_iconst_if_icmpgt,    load,      iconst,    if_icmpgt)              \
+    x3(load_iconst_if_icmple,    load,      iconst,    if_icmple)              \
+    x2(load_load,                load,      load)                              \
+    x3(load_load_iadd,           load,      load,      iadd)                   \
+    x4(load_load_iadd_store,     load,      load,      iadd,     store)        \
+    x2(load_getfield,            load,      getfield)
+
 enum class opc : uint8_t {
-    iconst,
-    lconst,
-    fconst,
-    dconst,
-    aconst,
-
-    load,
-    store,
-
-    barrayload,
-    sarrayload,
-    iarrayload,
-    larrayload,
-    carrayload,
-    farrayload,
-    darrayload,
-    aarrayload,
-    barraystore,
-    sarraystore,
-    iarraystore,
-    larraystore,
-    carraystore,
-    farraystore,
-    darraystore,
-    aarraystore,
-
-    pop,
-    dup,
-    dup_x1,
-    swap,
-
-    iadd,
-    isub,
-    imul,
-    idiv,
-    irem,
-    ineg,
-    ishl,
-    ishr,
-    iushr,
-    iand,
-    ior,
-    ixor,
-
-    ladd,
-    lsub,
-    lmul,
-    ldiv,
-    lrem,
-    lneg,
-    lshl,
-    lshr,
-    lushr,
-    land,
-    lor,
-    lxor,
-
-    fadd,
-    fsub,
-    fmul,
-    fdiv,
-    frem,
-    fneg,
-
-    dadd,
-    dsub,
-    dmul,
-    ddiv,
-    drem,
-    dneg,
-
-    iinc,
-
-    i2l,
-    i2f,
-    i2d,
-    l2i,
-    l2f,
-    l2d,
-    f2i,
-    f2l,
-    f2d,
-    d2i,
-    d2l,
-    d2f,
-    i2b,
-    i2c,
-    i2s,
-
-    lcmp,
-    fcmpl,
-    fcmpg,
-    dcmpl,
-    dcmpg,
-
-    ifeq,
-    ifne,
-    iflt,
-    ifge,
-    ifgt,
-    ifle,
-
-    if_icmpeq,
-    if_icmpne,
-    if_icmplt,
-    if_icmpge,
-    if_icmpgt,
-    if_icmple,
-    if_acmpeq,
-    if_acmpne,
-
-    goto_,
-
-    tableswitch,
-
-    ret,
-    ret_void,
-
-    getstatic,
-    putstatic,
-    getfield,
-    putfield,
-
-    invokevirtual,
-    invokespecial,
-    invokestatic,
-    invokeinterface,
-
-    new_,
-    newarray,
-    anewarray,
-    multianewarray,
-
-    arraylength,
-
-    athrow,
-
-    checkcast,
-    instanceof,
-
-    monitorenter,
-    monitorexit,
-
-    ifnull,
-    ifnonnull,
+#define OPC_ENUM(name, ...) name,
+    INTERP_OPCODES(OPC_ENUM)
+    INTERP_SUPERINSTRUCTIONS(OPC_ENUM, OPC_ENUM, OPC_ENUM)
+#undef OPC_ENUM
+};
+
+static const char* opc_names[] = {
+#define OPC_NAME(name, ...) #name,
+    INTERP_OPCODES(OPC_NAME)
+    INTERP_SUPERINSTRUCTIONS(OPC_NAME, OPC_NAME, OPC_NAME)
+#undef OPC_NAME
 };
 
+// Dynamic instruction n-gram counts gathered by the profiling interpreter.
+// The key packs the opcodes of an n-gram into the low three bytes and its
+// length into the top byte.
+static std::unordered_map<uint32_t, uint64_t> instruction_ngrams;
+
+// Records the n-grams that end with opcode "x" and returns the new history,
+// which is packed like an n-gram key. Instruction sequences are not tracked
+// across basic block boundaries because superinstructions cannot span them.
+static uint32_t profile_instruction(uint32_t history, uint8_t x)
+{
+    if (x == static_cast<uint8_t>(opc::profile_block)) {
+        return 0;
+    }
+    auto len = std::min((history >> 24) + 1, 3u);
+    auto opcodes = ((history << 8) | x) & 0xffffff;
+    for (uint32_t n = 1; n <= len; n++) {
+        auto mask = (1u << (8 * n)) - 1;
+        instruction_ngrams[(n << 24) | (opcodes & mask)]++;
+    }
+    return (len << 24) | opcodes;
+}
+
+void interp_stats()
+{
+    if (!instruction_profile) {
+        return;
+    }
+    for (uint32_t n = 1; n <= 3; n++) {
+        std::vector<std::pair<uint64_t, uint32_t>> ngrams;
+        for (auto&& entry : instruction_ngrams) {
+            if (entry.first >> 24 == n) {
+                ngrams.emplace_back(entry.second, entry.first);
+            }
+        }
+        std::sort(ngrams.rbegin(), ngrams.rend());
+        fprintf(stderr, "Instruction %u-grams:\n", n);
+        fprintf(stderr, "             #  instructions\n");
+        for (size_t i = 0; i < ngrams.size() && i < 30; i++) {
+            fprintf(stderr, "%14lu ", ngrams[i].first);
+            for (int j = n - 1; j >= 0; j--) {
+                fprintf(stderr, " %s", opc_names[(ngrams[i].second >> (8 * j)) & 0xff]);
+            }
+            fprintf(stderr, "\n");
+        }
+    }
+}
+
 template<typename T>
-T read_const(const char* code, uint16_t& pc)
+T read_const(const char* code, uint32_t& pc)
 {
     auto* src = reinterpret_cast<const T*>(code + pc);
     pc += sizeof(T);
     return *src;
 }
 
-uint16_t read_label(const char* code, uint16_t& pc)
+uint32_t read_label(const char* code, uint32_t& pc)
 {
-    return read_const<uint16_t>(code, pc);
+    return read_const<uint32_t>(code, pc);
 }
 
+// Inline caches are aligned in the trampoline so that their entries can be
+// updated atomically.
+static uint32_t align_inline_cache(uint32_t pc)
+{
+    auto align = alignof(inline_cache);
+    return (pc + align - 1) & ~(align - 1);
+}
+
+// Inline caches and quickened opcodes are the only parts of a trampoline that
+// are written to after translation.
+inline_cache* read_inline_cache(const char* code, uint32_t& pc)
+{
+    pc = align_inline_cache(pc);
+    auto* cache = reinterpret_cast<inline_cache*>(const_cast<char*>(code + pc));
+    pc += sizeof(inline_cache);
+    return cache;
+}
+
+// Rewrite the instruction at "opc_pc" into its quick form that skips the class
+// initialization barrier. Other threads may be executing the same trampoline,
+// so the rewrite has to be a single store. Direct-threaded handler addresses
+// are not aligned but x86-64 stores them atomically unless they straddle a
+// cache line, in which case the instruction keeps its barrier.
+template<bool threaded>
+static void quicken(const char* code, uint32_t opc_pc, void* const* dispatch_table, opc quick)
+{
+    auto* p = const_cast<char*>(code + opc_pc);
+    if (threaded) {
+#ifdef __x86_64__
+        auto offset = reinterpret_cast<uintptr_t>(p) % 64;
+        if (offset + sizeof(void*) > 64) {
+            return;
+        }
+#else
+        if (reinterpret_cast<uintptr_t>(p) % alignof(void*)) {
+            return;
+        }
+#endif
+        __atomic_store_n(reinterpret_cast<void**>(p), dispatch_table[static_cast<uint8_t>(quick)], __ATOMIC_RELEASE);
+    } else {
+        __atomic_store_n(p, static_cast<char>(quick), __ATOMIC_RELEASE);
+    }
+}
+
+// Handler bodies of the instructions that are superinstruction components.
+// A body executes the instruction without dispatching so that superinstruction
+// handlers can be generated by concatenating the bodies of their components.
+#define OPC_BODY_load                                                   \
+    {                                                                   \
+        auto idx = read_const<uint16_t>(code, pc);                      \
+        op_load(frame, idx);                                            \
+    }
+#define OPC_BODY_store                                                  \
+    {                                                                   \
+        auto idx = read_const<uint16_t>(code, pc);                      \
+        op_store(frame, idx);                                           \
+    }
+#define OPC_BODY_iconst                                                 \
+    {                                                                   \
+        auto value = read_const<jint>(code, pc);                        \
+        op_const(frame, value);                                         \
+    }
+#define OPC_BODY_iadd                                                   \
+    {                                                                   \
+        op_binary<jint>(frame, binop::op_add);                          \
+    }
+#define OPC_BODY_iinc                                                   \
+    {                                                                   \
+        auto idx = read_const<uint8_t>(code, pc);                       \
+        auto value = read_const<jint>(code, pc);                        \
+        op_iinc(frame, idx, value);                                     \
+    }
+#define OPC_BODY_if_icmp(op)                                            \
+    {                                                                   \
+        auto offset = read_label(code, pc);                             \
+        op_if_cmp<jint>(frame, pc, op, offset);                         \
+    }
+#define OPC_BODY_if_icmpeq OPC_BODY_if_icmp(cmpop::op_cmpeq)
+#define OPC_BODY_if_icmpne OPC_BODY_if_icmp(cmpop::op_cmpne)
+#define OPC_BODY_if_icmplt OPC_BODY_if_icmp(cmpop::op_cmplt)
+#define OPC_BODY_if_icmpge OPC_BODY_if_icmp(cmpop::op_cmpge)
+#define OPC_BODY_if_icmpgt OPC_BODY_if_icmp(cmpop::op_cmpgt)
+#define OPC_BODY_if_icmple OPC_BODY_if_icmp(cmpop::op_cmple)
+#define OPC_BODY_goto_                                                  \
+    {                                                                   \
+        pc = read_label(code, pc);                                      \
+    }
+#define OPC_BODY_getfield                                               \
+    {                                                                   \
+        auto* target = read_const<field*>(code, pc);                    \
+        op_getfield(target, frame);                                     \
+    }
+#define OPC_BODY_invokevirtual                                          \
+    {                                                                   \
+        auto* target = read_const<method*>(code, pc);                   \
+        frame.pc = pc;                                                  \
+        op_invokevirtual(target, frame);                                \
+    }
+#define OPC_BODY_flush_s1                                               \
+    {                                                                   \
+        frame.ostack_push(tos0);                                        \
+    }
+#define OPC_BODY_iconst_s0                                              \
+    {                                                                   \
+        tos0 = to_value(read_const<jint>(code, pc));                    \
+    }
+#define OPC_BODY_iconst_s1                                              \
+    {                                                                   \
+        tos1 = to_value(read_const<jint>(code, pc));                    \
+    }
+#define OPC_BODY_load_s0                                                \
+    {                                                                   \
+        auto idx = read_const<uint16_t>(code, pc);                      \
+        tos0 = frame.locals[idx];                                       \
+    }
+#define OPC_BODY_load_s1                                                \
+    {                                                                   \
+        auto idx = read_const<uint16_t>(code, pc);                      \
+        tos1 = frame.locals[idx];                                       \
+    }
+#define OPC_BODY_store_s1                                               \
+    {                                                                   \
+        auto idx = read_const<uint16_t>(code, pc);                      \
+        frame.locals[idx] = tos0;                                       \
+    }
+#define OPC_BODY_iadd_s1                                                \
+    {                                                                   \
+        tos0 = op_binary_s1<jint>(frame, binop::op_add, tos0);          \
+    }
+#define OPC_BODY_iadd_s2                                                \
+    {                                                                   \
+        tos0 = op_binary_s2<jint>(binop::op_add, tos0, tos1);           \
+    }
+#define OPC_BODY_if_icmp_s2(op)                                         \
+    {                                                                   \
+        auto offset = read_label(code, pc);                             \
+        op_if_cmp_s2<jint>(frame, pc, op, offset, tos0, tos1);          \
+    }
+#define OPC_BODY_if_icmpeq_s2 OPC_BODY_if_icmp_s2(cmpop::op_cmpeq)
+#define OPC_BODY_if_icmpne_s2 OPC_BODY_if_icmp_s2(cmpop::op_cmpne)
+#define OPC_BODY_if_icmplt_s2 OPC_BODY_if_icmp_s2(cmpop::op_cmplt)
+#define OPC_BODY_if_icmpge_s2 OPC_BODY_if_icmp_s2(cmpop::op_cmpge)
+#define OPC_BODY_if_icmpgt_s2 OPC_BODY_if_icmp_s2(cmpop::op_cmpgt)
+#define OPC_BODY_if_icmple_s2 OPC_BODY_if_icmp_s2(cmpop::op_cmple)
+
+// The interpreter loop. The trampoline "code" is either in byte format, where
+// each instruction starts with a one byte opcode that is looked up from
+// dispatch_table, or in direct-threaded format, where each instruction starts
+// with the address of its handler. Calling the direct-threaded variant with
+// a null "code" returns the address of its dispatch table, which is what the
+// translator uses to look up handler addresses. The profiling variant runs
+// byte format code and records instruction n-grams at every dispatch.
+template<bool threaded, bool profile>
 value_t interp(frame& frame, const char *code)
 {
     static void* dispatch_table[] = {
-        &&op_iconst,
-        &&op_lconst,
-        &&op_fconst,
-        &&op_dconst,
-        &&op_aconst,
-
-        &&op_load,
-        &&op_store,
-
-        &&op_barrayload,
-        &&op_sarrayload,
-        &&op_iarrayload,
-        &&op_larrayload,
-        &&op_carrayload,
-        &&op_farrayload,
-        &&op_darrayload,
-        &&op_aarrayload,
-        &&op_barraystore,
-        &&op_sarraystore,
-        &&op_iarraystore,
-        &&op_larraystore,
-        &&op_carraystore,
-        &&op_farraystore,
-        &&op_darraystore,
-        &&op_aarraystore,
-
-        &&op_pop,
-        &&op_dup,
-        &&op_dup_x1,
-        &&op_swap,
-
-        &&op_iadd,
-        &&op_isub,
-        &&op_imul,
-        &&op_idiv,
-        &&op_irem,
-        &&op_ineg,
-        &&op_ishl,
-        &&op_ishr,
-        &&op_iushr,
-        &&op_iand,
-        &&op_ior,
-        &&op_ixor,
-
-        &&op_ladd,
-        &&op_lsub,
-        &&op_lmul,
-        &&op_ldiv,
-        &&op_lrem,
-        &&op_lneg,
-        &&op_lshl,
-        &&op_lshr,
-        &&op_lushr,
-        &&op_land,
-        &&op_lor,
-        &&op_lxor,
-
-        &&op_fadd,
-        &&op_fsub,
-        &&op_fmul,
-        &&op_fdiv,
-        &&op_frem,
-        &&op_fneg,
-
-        &&op_dadd,
-        &&op_dsub,
-        &&op_dmul,
-        &&op_ddiv,
-        &&op_drem,
-        &&op_dneg,
-
-        &&op_iinc,
-
-        &&op_i2l,
-        &&op_i2f,
-        &&op_i2d,
-        &&op_l2i,
-        &&op_l2f,
-        &&op_l2d,
-        &&op_f2i,
-        &&op_f2l,
-        &&op_f2d,
-        &&op_d2i,
-        &&op_d2l,
-        &&op_d2f,
-        &&op_i2b,
-        &&op_i2c,
-        &&op_i2s,
-
-        &&op_lcmp,
-        &&op_fcmpl,
-        &&op_fcmpg,
-        &&op_dcmpl,
-        &&op_dcmpg,
-
-        &&op_ifeq,
-        &&op_ifne,
-        &&op_iflt,
-        &&op_ifge,
-        &&op_ifgt,
-        &&op_ifle,
-
-        &&op_if_icmpeq,
-        &&op_if_icmpne,
-        &&op_if_icmplt,
-        &&op_if_icmpge,
-        &&op_if_icmpgt,
-        &&op_if_icmple,
-        &&op_if_acmpeq,
-        &&op_if_acmpne,
-
-        &&op_goto,
-
-        &&op_tableswitch,
-
-        &&op_ret,
-        &&op_ret_void,
-
-        &&op_getstatic,
-        &&op_putstatic,
-        &&op_getfield,
-        &&op_putfield,
-
-        &&op_invokevirtual,
-        &&op_invokespecial,
-        &&op_invokestatic,
-        &&op_invokeinterface,
-
-        &&op_new,
-        &&op_newarray,
-        &&op_anewarray,
-        &&op_multianewarray,
-
-        &&op_arraylength,
-
-        &&op_athrow,
-
-        &&op_checkcast,
-        &&op_instanceof,
-
-        &&op_monitorenter,
-        &&op_monitorexit,
-
-        &&op_ifnull,
-        &&op_ifnonnull,
+#define OPC_LABEL(name, ...) &&op_##name,
+        INTERP_OPCODES(OPC_LABEL)
+        INTERP_SUPERINSTRUCTIONS(OPC_LABEL, OPC_LABEL, OPC_LABEL)
+#undef OPC_LABEL
     };
 
-    #define dispatch() goto *dispatch_table[(int)code[frame.pc++]]
+    if (threaded && !code) {
+        return reinterpret_cast<value_t>(dispatch_table);
+    }
 
-    frame.pc = 0;
+    #define dispatch()                                                  \
+        do {                                                            \
+            if (threaded) {                                             \
+                goto *read_const<void*>(code, pc);                      \
+            }                                                           \
+            if (profile) {                                              \
+                history = profile_instruction(history, code[pc]);       \
+            }                                                           \
+            goto *dispatch_table[static_cast<uint8_t>(code[pc++])];     \
+        } while (0)
+
+    // Size of the opcode or handler address that precedes the operands of
+    // an instruction.
+    const uint32_t opc_size = threaded ? sizeof(void*) : sizeof(opc);
+
+    #define quicken_if_initialized(klass, quick)                        \
+        do {                                                            \
+            if ((klass)->is_initialized()) {                            \
+                quicken<threaded>(code, opc_pc, dispatch_table, opc::quick); \
+            }                                                           \
+        } while (0)
+
+    // Opcodes of the previously executed instructions in the current basic
+    // block when profiling.
+    uint32_t history = 0;
+
+    // Operand stack values cached in registers by the stack-cached
+    // instruction variants. With two cached values, tos1 is the top.
+    value_t tos0 = 0, tos1 = 0;
+
+    uint32_t pc = 0;
 
     dispatch();
 
     while (1) {
         op_iconst: {
-            auto value = read_const<jint>(code, frame.pc);
-            op_const(frame, value);
+            OPC_BODY_iconst;
             dispatch();
         }
         op_lconst: {
-            auto value = read_const<jlong>(code, frame.pc);
+            auto value = read_const<jlong>(code, pc);
             op_const(frame, value);
             dispatch();
         }
         op_fconst: {
-            auto value = read_const<jfloat>(code, frame.pc);
+            auto value = read_const<jfloat>(code, pc);
             op_const(frame, value);
             dispatch();
         }
         op_dconst: {
-            auto value = read_const<jdouble>(code, frame.pc);
+            auto value = read_const<jdouble>(code, pc);
             op_const(frame, value);
             dispatch();
         }
         op_aconst: {
-            auto value = read_const<object*>(code, frame.pc);
-            op_const(frame, value);
+            auto* slot = read_const<object* const*>(code, pc);
+            op_const(frame, *slot);
             dispatch();
         }
         op_load: {
-            auto idx = read_const<uint16_t>(code, frame.pc);
-            op_load(frame, idx);
+            OPC_BODY_load;
             dispatch();
         }
         op_store: {
-            auto idx = read_const<uint16_t>(code, frame.pc);
-            op_store(frame, idx);
+            OPC_BODY_store;
             dispatch();
         }
         op_barrayload: {
@@ -1015,7 +1446,7 @@ value_t interp(frame& frame, const char *code)
             dispatch();
         }
         op_iadd: {
-            op_binary<jint>(frame, binop::op_add);
+            OPC_BODY_iadd;
             dispatch();
         }
         op_isub: {
@@ -1162,9 +1593,7 @@ value_t interp(frame& frame, const char *code)
             return to_value<object*>(nullptr);
         }
         op_iinc: {
-            auto idx = read_const<uint8_t>(code, frame.pc);
-            auto value = read_const<jint>(code, frame.pc);
-            op_iinc(frame, idx, value);
+            OPC_BODY_iinc;
             dispatch();
         }
         op_i2l: {
@@ -1248,88 +1677,81 @@ value_t interp(frame& frame, const char *code)
             dispatch();
         }
         op_ifeq: {
-            auto offset = read_label(code, frame.pc);
-            op_if<jint>(frame, cmpop::op_cmpeq, offset);
+            auto offset = read_label(code, pc);
+            op_if<jint>(frame, pc, cmpop::op_cmpeq, offset);
             dispatch();
         }
         op_ifne: {
-            auto offset = read_label(code, frame.pc);
-            op_if<jint>(frame, cmpop::op_cmpne, offset);
+            auto offset = read_label(code, pc);
+            op_if<jint>(frame, pc, cmpop::op_cmpne, offset);
             dispatch();
         }
         op_iflt: {
-            auto offset = read_label(code, frame.pc);
-            op_if<jint>(frame, cmpop::op_cmplt, offset);
+            auto offset = read_label(code, pc);
+            op_if<jint>(frame, pc, cmpop::op_cmplt, offset);
             dispatch();
         }
         op_ifge: {
-            auto offset = read_label(code, frame.pc);
-            op_if<jint>(frame, cmpop::op_cmpge, offset);
+            auto offset = read_label(code, pc);
+            op_if<jint>(frame, pc, cmpop::op_cmpge, offset);
             dispatch();
         }
         op_ifgt: {
-            auto offset = read_label(code, frame.pc);
-            op_if<jint>(frame, cmpop::op_cmpgt, offset);
+            auto offset = read_label(code, pc);
+            op_if<jint>(frame, pc, cmpop::op_cmpgt, offset);
             dispatch();
         }
         op_ifle: {
-            auto offset = read_label(code, frame.pc);
-            op_if<jint>(frame, cmpop::op_cmple, offset);
+            auto offset = read_label(code, pc);
+            op_if<jint>(frame, pc, cmpop::op_cmple, offset);
             dispatch();
         }
         op_if_icmpeq: {
-            auto offset = read_label(code, frame.pc);
-            op_if_cmp<jint>(frame, cmpop::op_cmpeq, offset);
+            OPC_BODY_if_icmpeq;
             dispatch();
         }
         op_if_icmpne: {
-            auto offset = read_label(code, frame.pc);
-            op_if_cmp<jint>(frame, cmpop::op_cmpne, offset);
+            OPC_BODY_if_icmpne;
             dispatch();
         }
         op_if_icmplt: {
-            auto offset = read_label(code, frame.pc);
-            op_if_cmp<jint>(frame, cmpop::op_cmplt, offset);
+            OPC_BODY_if_icmplt;
             dispatch();
         }
         op_if_icmpge: {
-            auto offset = read_label(code, frame.pc);
-            op_if_cmp<jint>(frame, cmpop::op_cmpge, offset);
+            OPC_BODY_if_icmpge;
             dispatch();
         }
         op_if_icmpgt: {
-            auto offset = read_label(code, frame.pc);
-            op_if_cmp<jint>(frame, cmpop::op_cmpgt, offset);
+            OPC_BODY_if_icmpgt;
             dispatch();
         }
         op_if_icmple: {
-            auto offset = read_label(code, frame.pc);
-            op_if_cmp<jint>(frame, cmpop::op_cmple, offset);
+            OPC_BODY_if_icmple;
             dispatch();
         }
         op_if_acmpeq: {
-            auto offset = read_label(code, frame.pc);
-            op_if_cmp<object*>(frame, cmpop::op_cmpeq, offset);
+            auto offset = read_label(code, pc);
+            op_if_cmp<object*>(frame, pc, cmpop::op_cmpeq, offset);
             dispatch();
         }
         op_if_acmpne: {
-            auto offset = read_label(code, frame.pc);
-            op_if_cmp<object*>(frame, cmpop::op_cmpne, offset);
+            auto offset = read_label(code, pc);
+            op_if_cmp<object*>(frame, pc, cmpop::op_cmpne, offset);
             dispatch();
         }
-        op_goto: {
-            auto offset = read_label(code, frame.pc);
-            frame.pc = offset;
+        op_goto_: {
+            OPC_BODY_goto_;
             dispatch();
         }
         op_tableswitch: {
-            auto high  = read_const<int32_t>(code, frame.pc);
-            auto low   = read_const<int32_t>(code, frame.pc);
-            auto def   = read_label(code, frame.pc);
-            auto size  = read_const<uint32_t>(code, frame.pc);
-            auto table = reinterpret_cast<const uint16_t*>(code + frame.pc);
-            frame.pc += size * sizeof(uint16_t);
-            op_tableswitch(frame, high, low, def, table);
+            auto high  = read_const<int32_t>(code, pc);
+            auto low   = read_const<int32_t>(code, pc);
+            auto def   = read_label(code, pc);
+            auto size  = read_const<uint32_t>(code, pc);
+            auto table = reinterpret_cast<const uint32_t*>(code + pc);
+            pc += size * sizeof(uint32_t);
+            op_tableswitch(frame, pc, high, low, def, table);
             dispatch();
         }
         op_ret: {
@@ -1338,63 +1760,85 @@ value_t interp(frame& frame, const char *code)
             return value;
         }
         op_getstatic: {
-            auto* target = read_const<field*>(code, frame.pc);
+            auto opc_pc = pc - opc_size;
+            auto* target = read_const<field*>(code, pc);
+            read_const<value_t*>(code, pc);
+            // Class initialization can call into the GC, which finds the
+            // GC map of the frame from the code offset that follows the
+            // instruction.
+            frame.pc = pc;
             op_getstatic(target, frame);
+            quicken_if_initialized(target->klass, getstatic_quick);
             dispatch();
         }
         op_putstatic: {
-            auto* target = read_const<field*>(code, frame.pc);
+            auto opc_pc = pc - opc_size;
+            auto* target = read_const<field*>(code, pc);
+            read_const<value_t*>(code, pc);
+            frame.pc = pc;
             op_putstatic(target, frame);
+            quicken_if_initialized(target->klass, putstatic_quick);
             dispatch();
         }
         op_getfield: {
-            auto* target = read_const<field*>(code, frame.pc);
-            op_getfield(target, frame);
+            OPC_BODY_getfield;
             dispatch();
         }
         op_putfield: {
-            auto* target = read_const<field*>(code, frame.pc);
+            auto* target = read_const<field*>(code, pc);
             op_putfield(target, frame);
             dispatch();
         }
         op_invokevirtual: {
-            auto* target = read_const<method*>(code, frame.pc);
-            op_invokevirtual(target, frame);
+            OPC_BODY_invokevirtual;
             dispatch();
         }
         op_invokespecial: {
-            auto* target = read_const<method*>(code, frame.pc);
+            auto* target = read_const<method*>(code, pc);
+            frame.pc = pc;
             op_invokespecial(target, frame);
             dispatch();
         }
         op_invokestatic: {
-            auto* target = read_const<method*>(code, frame.pc);
-            op_invokestatic(target, frame);
+            auto opc_pc = pc - opc_size;
+            auto* target = read_const<method*>(code, pc);
+            frame.pc = pc;
+            target->klass->init();
+            quicken_if_initialized(target->klass, invokestatic_quick);
+            op_invokestatic_quick(target, frame);
             dispatch();
         }
         op_invokeinterface: {
-            auto* target = read_const<method*>(code, frame.pc);
-            op_invokeinterface(target, frame);
+            auto* target = read_const<method*>(code, pc);
+            auto* cache = read_inline_cache(code, pc);
+            frame.pc = pc;
+            op_invokeinterface(target, cache, frame);
             dispatch();
         }
-        op_new: {
-            auto* type = read_const<klass*>(code, frame.pc);
+        op_new_: {
+            auto opc_pc = pc - opc_size;
+            auto* type = read_const<klass*>(code, pc);
+            frame.pc = pc;
             op_new(type, frame);
+            quicken_if_initialized(type, new_quick);
             dispatch();
         }
         op_newarray: {
-            auto atype = read_const<uint8_t>(code, frame.pc);
+            auto atype = read_const<uint8_t>(code, pc);
+            frame.pc = pc;
             op_newarray(atype, frame);
             dispatch();
         }
         op_anewarray: {
-            auto* type = read_const<klass*>(code, frame.pc);
+            auto* type = read_const<klass*>(code, pc);
+            frame.pc = pc;
             op_anewarray(type, frame);
             dispatch();
         }
         op_multianewarray: {
-            auto* type = read_const<klass*>(code, frame.pc);
-            auto dimensions = read_const<uint8_t>(code, frame.pc);
+            auto* type = read_const<klass*>(code, pc);
+            auto dimensions = read_const<uint8_t>(code, pc);
+            frame.pc = pc;
             op_multianewarray(type, dimensions, frame);
             dispatch();
         }
@@ -1407,12 +1851,12 @@ value_t interp(frame& frame, const char *code)
             dispatch();
         }
         op_checkcast: {
-            auto* type = read_const<klass*>(code, frame.pc);
+            auto* type = read_const<klass*>(code, pc);
             op_checkcast(frame, type);
             dispatch();
         }
         op_instanceof: {
-            auto* type = read_const<klass*>(code, frame.pc);
+            auto* type = read_const<klass*>(code, pc);
             op_instanceof(frame, type);
             dispatch();
         }
@@ -1425,28 +1869,316 @@ value_t interp(frame& frame, const char *code)
             dispatch();
         }
         op_ifnull: {
-            auto offset = read_label(code, frame.pc);
-            op_if<object*>(frame, cmpop::op_cmpeq, offset);
+            auto offset = read_label(code, pc);
+            op_if<object*>(frame, pc, cmpop::op_cmpeq, offset);
             dispatch();
         }
         op_ifnonnull: {
-            auto offset = read_label(code, frame.pc);
-            op_if<object*>(frame, cmpop::op_cmpne, offset);
+            auto offset = read_label(code, pc);
+            op_if<object*>(frame, pc, cmpop::op_cmpne, offset);
+            dispatch();
+        }
+        op_profile_block: {
+            dispatch();
+        }
+        op_getstatic_quick: {
+            read_const<field*>(code, pc);
+            auto* addr = read_const<value_t*>(code, pc);
+            op_getstatic_quick(addr, frame);
+            dispatch();
+        }
+        op_putstatic_quick: {
+            read_const<field*>(code, pc);
+            auto* addr = read_const<value_t*>(code, pc);
+            op_putstatic_quick(addr, frame);
+            dispatch();
+        }
+        op_invokestatic_quick: {
+            auto* target = read_const<method*>(code, pc);
+            frame.pc = pc;
+            op_invokestatic_quick(target, frame);
+            dispatch();
+        }
+        op_new_quick: {
+            auto* type = read_const<klass*>(code, pc);
+            frame.pc = pc;
+            op_new_quick(type, frame);
+            dispatch();
+        }
+        op_flush_s1: {
+            OPC_BODY_flush_s1;
+            dispatch();
+        }
+        op_flush_s2: {
+            frame.ostack_push(tos0);
+            frame.ostack_push(tos1);
+            dispatch();
+        }
+        op_iconst_s0: {
+            OPC_BODY_iconst_s0;
+            dispatch();
+        }
+        op_iconst_s1: {
+            OPC_BODY_iconst_s1;
+            dispatch();
+        }
+        op_iconst_s2: {
+            frame.ostack_push(tos0);
+            tos0 = tos1;
+            tos1 = to_value(read_const<jint>(code, pc));
+            dispatch();
+        }
+        op_load_s0: {
+            OPC_BODY_load_s0;
+            dispatch();
+        }
+        op_load_s1: {
+            OPC_BODY_load_s1;
+            dispatch();
+        }
+        op_load_s2: {
+            auto idx = read_const<uint16_t>(code, pc);
+            frame.ostack_push(tos0);
+            tos0 = tos1;
+            tos1 = frame.locals[idx];
+            dispatch();
+        }
+        op_store_s1: {
+            OPC_BODY_store_s1;
+            dispatch();
+        }
+        op_store_s2: {
+            auto idx = read_const<uint16_t>(code, pc);
+            frame.locals[idx] = tos1;
+            dispatch();
+        }
+        op_iadd_s1: {
+            OPC_BODY_iadd_s1;
+            dispatch();
+        }
+        op_iadd_s2: {
+            OPC_BODY_iadd_s2;
+            dispatch();
+        }
+        op_isub_s1: {
+            tos0 = op_binary_s1<jint>(frame, binop::op_sub, tos0);
+            dispatch();
+        }
+        op_isub_s2: {
+            tos0 = op_binary_s2<jint>(binop::op_sub, tos0, tos1);
+            dispatch();
+        }
+        op_imul_s1: {
+            tos0 = op_binary_s1<jint>(frame, binop::op_mul, tos0);
+            dispatch();
+        }
+        op_imul_s2: {
+            tos0 = op_binary_s2<jint>(binop::op_mul, tos0, tos1);
+            dispatch();
+        }
+        op_ishl_s1: {
+            tos0 = op_shift_s1<jint>(frame, shiftop::op_shl, 0x1f, tos0);
+            dispatch();
+        }
+        op_ishl_s2: {
+            tos0 = op_shift_s2<jint>(shiftop::op_shl, 0x1f, tos0, tos1);
+            dispatch();
+        }
+        op_ishr_s1: {
+            tos0 = op_shift_s1<jint>(frame, shiftop::op_shr, 0x1f, tos0);
+            dispatch();
+        }
+        op_ishr_s2: {
+            tos0 = op_shift_s2<jint>(shiftop::op_shr, 0x1f, tos0, tos1);
             dispatch();
         }
+        op_iushr_s1: {
+            tos0 = op_shift_s1<uint32_t>(frame, shiftop::op_shr, 0x1f, tos0);
+            dispatch();
+        }
+        op_iushr_s2: {
+            tos0 = op_shift_s2<uint32_t>(shiftop::op_shr, 0x1f, tos0, tos1);
+            dispatch();
+        }
+        op_iand_s1: {
+            tos0 = op_binary_s1<jint>(frame, binop::op_and, tos0);
+            dispatch();
+        }
+        op_iand_s2: {
+            tos0 = op_binary_s2<jint>(binop::op_and, tos0, tos1);
+            dispatch();
+        }
+        op_ior_s1: {
+            tos0 = op_binary_s1<jint>(frame, binop::op_or, tos0);
+            dispatch();
+        }
+        op_ior_s2: {
+            tos0 = op_binary_s2<jint>(binop::op_or, tos0, tos1);
+            dispatch();
+        }
+        op_ixor_s1: {
+            tos0 = op_binary_s1<jint>(frame, binop::op_xor, tos0);
+            dispatch();
+        }
+        op_ixor_s2: {
+            tos0 = op_binary_s2<jint>(binop::op_xor, tos0, tos1);
+            dispatch();
+        }
+        op_ifeq_s1: {
+            auto offset = read_label(code, pc);
+            op_if_s1<jint>(frame, pc, cmpop::op_cmpeq, offset, tos0);
+            dispatch();
+        }
+        op_ifne_s1: {
+            auto offset = read_label(code, pc);
+            op_if_s1<jint>(frame, pc, cmpop::op_cmpne, offset, tos0);
+            dispatch();
+        }
+        op_iflt_s1: {
+            auto offset = read_label(code, pc);
+            op_if_s1<jint>(frame, pc, cmpop::op_cmplt, offset, tos0);
+            dispatch();
+        }
+        op_ifge_s1: {
+            auto offset = read_label(code, pc);
+            op_if_s1<jint>(frame, pc, cmpop::op_cmpge, offset, tos0);
+            dispatch();
+        }
+        op_ifgt_s1: {
+            auto offset = read_label(code, pc);
+            op_if_s1<jint>(frame, pc, cmpop::op_cmpgt, offset, tos0);
+            dispatch();
+        }
+        op_ifle_s1: {
+            auto offset = read_label(code, pc);
+            op_if_s1<jint>(frame, pc, cmpop::op_cmple, offset, tos0);
+            dispatch();
+        }
+        op_if_icmpeq_s1: {
+            auto offset = read_label(code, pc);
+            op_if_cmp_s1<jint>(frame, pc, cmpop::op_cmpeq, offset, tos0);
+            dispatch();
+        }
+        op_if_icmpeq_s2: {
+            OPC_BODY_if_icmpeq_s2;
+            dispatch();
+        }
+        op_if_icmpne_s1: {
+            auto offset = read_label(code, pc);
+            op_if_cmp_s1<jint>(frame, pc, cmpop::op_cmpne, offset, tos0);
+            dispatch();
+        }
+        op_if_icmpne_s2: {
+            OPC_BODY_if_icmpne_s2;
+            dispatch();
+        }
+        op_if_icmplt_s1: {
+            auto offset = read_label(code, pc);
+            op_if_cmp_s1<jint>(frame, pc, cmpop::op_cmplt, offset, tos0);
+            dispatch();
+        }
+        op_if_icmplt_s2: {
+            OPC_BODY_if_icmplt_s2;
+            dispatch();
+        }
+        op_if_icmpge_s1: {
+            auto offset = read_label(code, pc);
+            op_if_cmp_s1<jint>(frame, pc, cmpop::op_cmpge, offset, tos0);
+            dispatch();
+        }
+        op_if_icmpge_s2: {
+            OPC_BODY_if_icmpge_s2;
+            dispatch();
+        }
+        op_if_icmpgt_s1: {
+            auto offset = read_label(code, pc);
+            op_if_cmp_s1<jint>(frame, pc, cmpop::op_cmpgt, offset, tos0);
+            dispatch();
+        }
+        op_if_icmpgt_s2: {
+            OPC_BODY_if_icmpgt_s2;
+            dispatch();
+        }
+        op_if_icmple_s1: {
+            auto offset = read_label(code, pc);
+            op_if_cmp_s1<jint>(frame, pc, cmpop::op_cmple, offset, tos0);
+            dispatch();
+        }
+        op_if_icmple_s2: {
+            OPC_BODY_if_icmple_s2;
+            dispatch();
+        }
+#define OPC_SUPER2(name, a, b)                                          \
+        op_##name: {                                                    \
+            OPC_BODY_##a;                                               \
+            OPC_BODY_##b;                                               \
+            dispatch();                                                 \
+        }
+#define OPC_SUPER3(name, a, b, c)                                       \
+        op_##name: {                                                    \
+            OPC_BODY_##a;                                               \
+            OPC_BODY_##b;                                               \
+            OPC_BODY_##c;                                               \
+            dispatch();                                                 \
+        }
+#define OPC_SUPER4(name, a, b, c, d)                                    \
+        op_##name: {                                                    \
+            OPC_BODY_##a;                                               \
+            OPC_BODY_##b;                                               \
+            OPC_BODY_##c;                                               \
+            OPC_BODY_##d;                                               \
+            dispatch();                                                 \
+        }
+        INTERP_SUPERINSTRUCTIONS(OPC_SUPER2, OPC_SUPER3, OPC_SUPER4)
+#undef OPC_SUPER2
+#undef OPC_SUPER3
+#undef OPC_SUPER4
     }
 }
 
+// Returns the handler addresses of the direct-threaded interpreter, indexed
+// by opcode.
+static void* const* threaded_dispatch_table()
+{
+    static void* const* table = [] {
+        frame frame(nullptr, nullptr, 0, nullptr, nullptr);
+        return reinterpret_cast<void* const*>(interp<true, false>(frame, nullptr));
+    }();
+    return table;
+}
+
+// Returns the superinstruction that an instruction fuses into when it is
+// followed by another instruction, keyed by the opcodes of the two
+// instructions. Longer sequences are fused one instruction at a time.
+static const std::map<std::pair<opc, opc>, opc>& superinstruction_table()
+{
+    static const std::map<std::pair<opc, opc>, opc> table = [] {
+        std::map<std::pair<opc, opc>, opc> table;
+#define OPC_FUSE2(name, a, b)                                           \
+        table[{opc::a, opc::b}] = opc::name;
+#define OPC_FUSE3(name, a, b, c)                                        \
+        table[{table.at({opc::a, opc::b}), opc::c}] = opc::name;
+#define OPC_FUSE4(name, a, b, c, d)                                     \
+        table[{table.at({table.at({opc::a, opc::b}), opc::c}), opc::d}] = opc::name;
+        INTERP_SUPERINSTRUCTIONS(OPC_FUSE2, OPC_FUSE3, OPC_FUSE4)
+#undef OPC_FUSE2
+#undef OPC_FUSE3
+#undef OPC_FUSE4
+        return table;
+    }();
+    return table;
+}
+
 // A branch label that is backpatched to a branch offset after all basic blocks
 // are translated.
 class label {
 public:
     // The location of the branch offset that needs to be backpatched in code.
-    uint16_t pc;
+    uint32_t pc;
     // The target basic block of this branch label.
     std::shared_ptr<basic_block> bblock;
 
-    label(uint16_t pc_, std::shared_ptr<basic_block> bblock_)
+    label(uint32_t pc_, std::shared_ptr<basic_block> bblock_)
         : pc(pc_)
         , bblock(bblock_)
     { }
@@ -1459,6 +2191,10 @@ public:
 
     std::vector<uint8_t> trampoline();
 
+    std::unordered_map<uint32_t, gc_map> gc_maps() {
+        return std::move(_gc_maps);
+    }
+
     virtual void prologue() override;
     virtual void epilogue() override;
     virtual void begin(std::shared_ptr<basic_block> bblock) override;
@@ -1508,13 +2244,65 @@ public:
     virtual void op_monitorexit() override;
 
 private:
+    // Puts an instruction that expects the operand stack to be in memory.
     void put_opc(opc x) {
+      flush();
+      put_opc_raw(x);
+    }
+    // Puts the stack-cached variant of an instruction. The variants are laid
+    // out consecutively in the opc enumeration, starting from "first".
+    void put_cached_opc(opc first, uint8_t variant, uint8_t tos) {
+      put_opc_raw(static_cast<opc>(static_cast<uint8_t>(first) + variant));
+      _tos = tos;
+    }
+    // Spills operand stack values cached in registers back to memory.
+    void flush() {
+      switch (_tos) {
+      case 0:                               break;
+      case 1:  put_opc_raw(opc::flush_s1);  break;
+      case 2:  put_opc_raw(opc::flush_s2);  break;
+      default: assert(0);
+      }
+      _tos = 0;
+    }
+    void put_opc_raw(opc x) {
+      if (fuse(x)) {
+        return;
+      }
+      _last_opc = x;
+      _last_opc_pc = _pc;
+      _fusible = true;
+      if (threaded_code()) {
+        put_const(threaded_dispatch_table()[static_cast<uint8_t>(x)]);
+        return;
+      }
       _code.resize(_code.size() + sizeof(opc));
       auto* code = _code.data();
       code[_pc++] = static_cast<uint8_t>(x);
     }
+    // Fuses an instruction into the previous one if the two form a
+    // superinstruction. The operands of the instruction are put after the
+    // operands of the previous instruction, which is where the
+    // superinstruction handler expects them.
+    bool fuse(opc x) {
+      if (!superinstructions || instruction_profile || !_fusible) {
+        return false;
+      }
+      auto& table = superinstruction_table();
+      auto it = table.find({_last_opc, x});
+      if (it == table.end()) {
+        return false;
+      }
+      _last_opc = it->second;
+      if (threaded_code()) {
+        put_const(threaded_dispatch_table()[static_cast<uint8_t>(_last_opc)], _last_opc_pc);
+      } else {
+        _code[_last_opc_pc] = static_cast<uint8_t>(_last_opc);
+      }
+      return true;
+    }
     template<typename T>
-    void put_const(T x, uint16_t pc) {
+    void put_const(T x, uint32_t pc) {
       auto* code = _code.data() + pc;
       auto* dst = reinterpret_cast<T*>(code);
       *dst = x;
@@ -1525,30 +2313,57 @@ private:
      put_const(x, _pc);
       _pc += sizeof(T);
     }
+    // Records the GC map of the current instruction, which the interpreter
+    // looks up with the code offset that follows the instruction's operands.
+    void put_gc_point() {
+      _gc_maps[_pc] = _gc_map_builder.map_at(_insn_pc);
+    }
+    // Puts an empty inline cache to the instruction stream.
+    void put_inline_cache() {
+      auto pc = align_inline_cache(_pc);
+      _code.resize(pc + sizeof(inline_cache));
+      new (_code.data() + pc) inline_cache();
+      _pc = pc + sizeof(inline_cache);
+    }
     // Puts a zero offset to the instruction stream and registers the branch
     // for backpatching.
     void put_label(const std::shared_ptr<basic_block>& bblock) {
       _label_list.push_back(label(_pc, bblock));
-      put_const<uint16_t>(0);
+      put_const<uint32_t>(0);
     }
     void backpatch() {
       for (auto&& label : _label_list) {
         auto it = _bblock_map.find(label.bblock);
         assert(it != _bblock_map.end());
-        uint16_t offset = it->second;
+        uint32_t offset = it->second;
         put_const(offset, label.pc);
       }
     }
 
-    std::map<std::shared_ptr<basic_block>, uint16_t> _bblock_map;
+    std::map<std::shared_ptr<basic_block>, uint32_t> _bblock_map;
     std::vector<uint8_t> _code;
+    gc_map_builder _gc_map_builder;
+    std::unordered_map<uint32_t, gc_map> _gc_maps;
     std::vector<label> _label_list;
-    uint16_t _pc;
+    uint32_t _pc;
+    // Number of operand stack values cached in registers at this point of
+    // the translated code.
+    uint8_t _tos;
+    // The opcode and location of the previous instruction, and whether the
+    // next instruction can be fused into it.
+    opc _last_opc;
+    uint32_t _last_opc_pc;
+    bool _fusible;
 };
 
 interp_translator::interp_translator(method* method)
     : translator(method)
+    , _gc_map_builder(method)
     , _pc(0)
+    , _tos(0)
+    , _last_opc(opc::profile_block)
+    , _last_opc_pc(0)
+    , _fusible(false)
 {
 }
 
@@ -1563,6 +2378,7 @@ std::vector<uint8_t> interp_translator::trampoline()
 
 void interp_translator::prologue()
 {
+    _gc_map_builder.build();
 }
 
 void interp_translator::epilogue()
@@ -1572,14 +2388,27 @@ void interp_translator::epilogue()
 
 void interp_translator::begin(std::shared_ptr<basic_block> bblock)
 {
+    // Basic blocks start with an empty stack cache because they can be
+    // entered from more than one place.
+    flush();
+    // Superinstructions cannot span basic blocks because a branch target
+    // needs to start an instruction.
+    _fusible = false;
     _bblock_map.emplace(bblock, _pc);
+    if (instruction_profile) {
+        put_opc_raw(opc::profile_block);
+    }
 }
 
 void interp_translator::op_const(type t, int64_t value)
 {
     switch (t) {
     case type::t_int:
-        put_opc(opc::iconst);
+        if (stack_caching) {
+            put_cached_opc(opc::iconst_s0, _tos, std::min(_tos + 1, 2));
+        } else {
+            put_opc(opc::iconst);
+        }
         put_const<jint>(value);
         break;
     case type::t_long:
@@ -1594,23 +2423,33 @@ void interp_translator::op_const(type t, int64_t value)
         put_opc(opc::dconst);
         put_const<jdouble>(value);
         break;
-    case type::t_ref:
+    case type::t_ref: {
+        static object* const null_slot = nullptr;
         put_opc(opc::aconst);
-        put_const<object*>(reinterpret_cast<object*>(value));
+        put_const<object* const*>(value ? reinterpret_cast<object**>(value) : &null_slot);
         break;
+    }
     default: assert(0);
     }
 }
 
 void interp_translator::op_load(type t, uint16_t idx)
 {
-    put_opc(opc::load);
+    if (stack_caching) {
+        put_cached_opc(opc::load_s0, _tos, std::min(_tos + 1, 2));
+    } else {
+        put_opc(opc::load);
+    }
     put_const(idx);
 }
 
 void interp_translator::op_store(type t, uint16_t idx)
 {
-    put_opc(opc::store);
+    if (_tos > 0) {
+        put_cached_opc(opc::store_s1, _tos - 1, _tos - 1);
+    } else {
+        put_opc(opc::store);
+    }
     put_const(idx);
 }
 
@@ -1804,6 +2643,20 @@ void interp_translator::op_unary(type t, unaryop op)
 
 void interp_translator::op_binary(type t, binop op)
 {
+    if (t == type::t_int && _tos > 0) {
+        switch (op) {
+        case binop::op_add:  put_cached_opc(opc::iadd_s1,  _tos - 1, 1); return;
+        case binop::op_sub:  put_cached_opc(opc::isub_s1,  _tos - 1, 1); return;
+        case binop::op_mul:  put_cached_opc(opc::imul_s1,  _tos - 1, 1); return;
+        case binop::op_shl:  put_cached_opc(opc::ishl_s1,  _tos - 1, 1); return;
+        case binop::op_shr:  put_cached_opc(opc::ishr_s1,  _tos - 1, 1); return;
+        case binop::op_ushr: put_cached_opc(opc::iushr_s1, _tos - 1, 1); return;
+        case binop::op_and:  put_cached_opc(opc::iand_s1,  _tos - 1, 1); return;
+        case binop::op_or:   put_cached_opc(opc::ior_s1,   _tos - 1, 1); return;
+        case binop::op_xor:  put_cached_opc(opc::ixor_s1,  _tos - 1, 1); return;
+        default:             break;
+        }
+    }
     switch (t) {
     case type::t_int: {
         switch (op) {
@@ -1867,7 +2720,9 @@ void interp_translator::op_binary(type t, binop op)
 
 void interp_translator::op_iinc(uint8_t idx, jint value)
 {
-    put_opc(opc::iinc);
+    // The instruction does not touch the operand stack so there is no need
+    // to flush the stack cache.
+    put_opc_raw(opc::iinc);
     put_const(idx);
     put_const(value);
 }
@@ -1902,6 +2757,19 @@ void interp_translator::op_cmp(type t, cmpop op)
 
 void interp_translator::op_if(type t, cmpop op, std::shared_ptr<basic_block> target)
 {
+    if (t == type::t_int && _tos == 1) {
+        switch (op) {
+        case cmpop::op_cmpeq: put_cached_opc(opc::ifeq_s1, 0, 0); break;
+        case cmpop::op_cmpne: put_cached_opc(opc::ifne_s1, 0, 0); break;
+        case cmpop::op_cmplt: put_cached_opc(opc::iflt_s1, 0, 0); break;
+        case cmpop::op_cmpge: put_cached_opc(opc::ifge_s1, 0, 0); break;
+        case cmpop::op_cmpgt: put_cached_opc(opc::ifgt_s1, 0, 0); break;
+        case cmpop::op_cmple: put_cached_opc(opc::ifle_s1, 0, 0); break;
+        default:              assert(0);
+        }
+        put_label(target);
+        return;
+    }
     switch (t) {
     case type::t_int: {
         switch (op) {
@@ -1931,6 +2799,19 @@ void interp_translator::op_if(type t, cmpop op, std::shared_ptr<basic_block> tar
 
 void interp_translator::op_if_cmp(type t, cmpop op, std::shared_ptr<basic_block> bblock)
 {
+    if (t == type::t_int && _tos > 0) {
+        switch (op) {
+        case cmpop::op_cmpeq: put_cached_opc(opc::if_icmpeq_s1, _tos - 1, 0); break;
+        case cmpop::op_cmpne: put_cached_opc(opc::if_icmpne_s1, _tos - 1, 0); break;
+        case cmpop::op_cmplt: put_cached_opc(opc::if_icmplt_s1, _tos - 1, 0); break;
+        case cmpop::op_cmpge: put_cached_opc(opc::if_icmpge_s1, _tos - 1, 0); break;
+        case cmpop::op_cmpgt: put_cached_opc(opc::if_icmpgt_s1, _tos - 1, 0); break;
+        case cmpop::op_cmple: put_cached_opc(opc::if_icmple_s1, _tos - 1, 0); break;
+        default:              assert(0);
+        }
+        put_label(bblock);
+        return;
+    }
     switch (t) {
     case type::t_int: {
         switch (op) {
@@ -1987,16 +2868,24 @@ void interp_translator::op_ret_void()
     put_opc(opc::ret_void);
 }
 
+// Static field accesses carry the address of the field value so that the
+// quick forms need not look it up. Instructions that refer to classes that are
+// already initialized are emitted in their quick form directly; the rest are
+// quickened by the interpreter once the class initializer has run.
 void interp_translator::op_getstatic(field* field)
 {
-    put_opc(opc::getstatic);
+    put_opc(field->klass->is_initialized() ? opc::getstatic_quick : opc::getstatic);
     put_const(field);
+    put_const(&field->klass->static_values[field->offset]);
+    put_gc_point();
 }
 
 void interp_translator::op_putstatic(field* field)
 {
-    put_opc(opc::putstatic);
+    put_opc(field->klass->is_initialized() ? opc::putstatic_quick : opc::putstatic);
     put_const(field);
+    put_const(&field->klass->static_values[field->offset]);
+    put_gc_point();
 }
 
 void interp_translator::op_getfield(field* field)
@@ -2015,42 +2904,50 @@ void interp_translator::op_invokevirtual(method* target)
 {
     put_opc(opc::invokevirtual);
     put_const(target);
+    put_gc_point();
 }
 
 void interp_translator::op_invokespecial(method* target)
 {
     put_opc(opc::invokespecial);
     put_const(target);
+    put_gc_point();
 }
 
 void interp_translator::op_invokestatic(method* target)
 {
-    put_opc(opc::invokestatic);
+    put_opc(target->klass->is_initialized() ? opc::invokestatic_quick : opc::invokestatic);
     put_const(target);
+    put_gc_point();
 }
 
 void interp_translator::op_invokeinterface(method* target)
 {
     put_opc(opc::invokeinterface);
     put_const(target);
+    put_inline_cache();
+    put_gc_point();
 }
 
 void interp_translator::op_new(klass* klass)
 {
-    put_opc(opc::new_);
+    put_opc(klass->is_initialized() ? opc::new_quick : opc::new_);
     put_const(klass);
+    put_gc_point();
 }
 
 void interp_translator::op_newarray(uint8_t atype)
 {
     put_opc(opc::newarray);
     put_const(atype);
+    put_gc_point();
 }
 
 void interp_translator::op_anewarray(klass* klass)
 {
     put_opc(opc::anewarray);
     put_const(klass);
+    put_gc_point();
 }
 
 void interp_translator::op_multianewarray(klass* klass, uint8_t dimensions)
@@ -2058,6 +2955,7 @@ void interp_translator::op_multianewarray(klass* klass, uint8_t dimensions)
     put_opc(opc::multianewarray);
     put_const(klass);
     put_const(dimensions);
+    put_gc_point();
 }
 
 void interp_translator::op_arraylength()
@@ -2099,9 +2997,17 @@ value_t interp_backend::execute(method* method, frame& frame)
 
         translator.translate();
 
+        method->gc_maps = translator.gc_maps();
         method->trampoline = translator.trampoline();
     }
-    return interp(frame, reinterpret_cast<const char*>(method->trampoline.data()));
+    auto* code = reinterpret_cast<const char*>(method->trampoline.data());
+    if (instruction_profile) {
+        return interp<false, true>(frame, code);
+    }
+    if (direct_threading) {
+        return interp<true, false>(frame, code);
+    }
+    return interp<false, false>(frame, code);
 }
 
 }
@@ -5,6 +5,7 @@
 #include "hornet/vm.hh"
 
 #include <cassert>
+#include <cstdlib>
 #include <cstring>
 #include <sstream>
 #include <jni.h>
@@ -26,6 +27,12 @@ static jint HORNET_JNI(DestroyJavaVM)(JavaVM *vm)
 
     hornet::verifier_stats();
 
+    hornet::interp_stats();
+
+    hornet::_jvm->intern_stats();
+
+    hornet::gc_stats();
+
     delete hornet::_jvm;
 
     return JNI_OK;
@@ -33,12 +40,18 @@ static jint HORNET_JNI(DestroyJavaVM)(JavaVM *vm)
 
 static jint HORNET_JNI(AttachCurrentThread)(JavaVM *vm, void **penv, void *args)
 {
-    assert(0);
+    hornet::thread::current()->attach();
+
+    *reinterpret_cast<JNIEnv **>(penv) = &HORNET_JNI(JNIEnv);
+
+    return JNI_OK;
 }
 
 static jint HORNET_JNI(DetachCurrentThread)(JavaVM *vm)
 {
-    assert(0);
+    hornet::thread::current()->detach();
+
+    return JNI_OK;
 }
 
 static jint HORNET_JNI(GetEnv)(JavaVM *vm, void **penv, jint version)
@@ -48,7 +61,7 @@ static jint HORNET_JNI(GetEnv)(JavaVM *vm, void **penv, jint version)
 
 static jint HORNET_JNI(AttachCurrentThreadAsDaemon)(JavaVM *vm, void **penv, void *args)
 {
-    assert(0);
+    return HORNET_JNI(AttachCurrentThread)(vm, penv, args);
 }
 
 static const struct JNIInvokeInterface_ HORNET_JNI(JNIInvokeInterface) = {
@@ -96,6 +109,47 @@ static bool option_matches(const char* option, const char* expected)
     return !strncmp(option, expected, strlen(option));
 }
 
+static bool option_prefix(const char* option, const char* prefix, const char** value)
+{
+    if (strncmp(option, prefix, strlen(prefix))) {
+        return false;
+    }
+    *value = option + strlen(prefix);
+    return true;
+}
+
+// Parses a size in bytes with an optional 'k', 'm' or 'g' suffix.
+static bool parse_size(const char* str, size_t* size)
+{
+    char* end;
+    auto value = strtoull(str, &end, 10);
+    if (end == str) {
+        return false;
+    }
+    switch (*end) {
+    case 'k': case 'K': value <<= 10; end++; break;
+    case 'm': case 'M': value <<= 20; end++; break;
+    case 'g': case 'G': value <<= 30; end++; break;
+    }
+    if (*end) {
+        return false;
+    }
+    *size = value;
+    return true;
+}
+
+// Parses a mortality, which is a fraction strictly between zero and one.
+static bool parse_mortality(const char* str, double* mortality)
+{
+    char* end;
+    auto value = strtod(str, &end);
+    if (end == str || *end || !(value > 0.0 && value < 1.0)) {
+        return false;
+    }
+    *mortality = value;
+    return true;
+}
+
 jint JNI_CreateJavaVM(JavaVM **vm, void **penv, void *args)
 {
     auto vm_args = reinterpret_cast<JavaVMInitArgs*>(args);
@@ -105,8 +159,11 @@ jint JNI_CreateJavaVM(JavaVM **vm, void **penv, void *args)
 
     auto backend = hornet::backend_type::interp;
 
+    auto initial_heap_size_set = false;
+
     for (auto i = 0; i < vm_args->nOptions; i++) {
         const char *opt = vm_args->options[i].optionString;
+        const char *value;
 
         if (option_matches(opt, "-cp") || option_matches(opt, "-classpath")) {
             classpath = std::string{vm_args->options[++i].optionString};
@@ -124,6 +181,116 @@ jint JNI_CreateJavaVM(JavaVM **vm, void **penv, void *args)
             hornet::verbose_compiler = true;
             continue;
         }
+        if (option_matches(opt, "-XX:+OverlappingFrames")) {
+            hornet::overlapping_frames = true;
+            continue;
+        }
+        if (option_matches(opt, "-XX:-OverlappingFrames")) {
+            hornet::overlapping_frames = false;
+            continue;
+        }
+        if (option_matches(opt, "-XX:+StackCaching")) {
+            hornet::stack_caching = true;
+            continue;
+        }
+        if (option_matches(opt, "-XX:-StackCaching")) {
+            hornet::stack_caching = false;
+            continue;
+        }
+        if (option_matches(opt, "-XX:+DirectThreading")) {
+            hornet::direct_threading = true;
+            continue;
+        }
+        if (option_matches(opt, "-XX:-DirectThreading")) {
+            hornet::direct_threading = false;
+            continue;
+        }
+        if (option_matches(opt, "-XX:+Superinstructions")) {
+            hornet::superinstructions = true;
+            continue;
+        }
+        if (option_matches(opt, "-XX:-Superinstructions")) {
+            hornet::superinstructions = false;
+            continue;
+        }
+        if (option_matches(opt, "-XX:+PrintInstructionProfile")) {
+            hornet::instruction_profile = true;
+            continue;
+        }
+        if (option_matches(opt, "-XX:+PrintStringTableStatistics")) {
+            hornet::print_string_table_stats = true;
+            continue;
+        }
+        if (option_matches(opt, "-XX:+PrintGCStatistics")) {
+            hornet::print_gc_stats = true;
+            continue;
+        }
+        if (option_prefix(opt, "-Xms", &value)) {
+            if (!parse_size(value, &hornet::gc_initial_heap_size) || !hornet::gc_initial_heap_size) {
+                fprintf(stderr, "error: Invalid initial heap size: '%s'\n", opt);
+                return JNI_ERR;
+            }
+            initial_heap_size_set = true;
+#ifdef CONFIG_COMPRESSED_OOPS
+            if (hornet::gc_initial_heap_size > hornet::max_compressed_heap_size) {
+                fprintf(stderr, "error: Initial heap size is too large for compressed references: '%s'\n", opt);
+                return JNI_ERR;
+            }
+#endif
+            continue;
+        }
+        if (option_prefix(opt, "-Xmx", &value)) {
+            if (!parse_size(value, &hornet::gc_max_heap_size) || !hornet::gc_max_heap_size) {
+                fprintf(stderr, "error: Invalid maximum heap size: '%s'\n", opt);
+                return JNI_ERR;
+            }
+#ifdef CONFIG_COMPRESSED_OOPS
+            if (hornet::gc_max_heap_size > hornet::max_compressed_heap_size) {
+                fprintf(stderr, "error: Maximum heap size is too large for compressed references: '%s'\n", opt);
+                return JNI_ERR;
+            }
+#endif
+            continue;
+        }
+        if (option_matches(opt, "-XX:+UseLargePages")) {
+            hornet::gc_large_pages = true;
+            continue;
+        }
+        if (option_matches(opt, "-XX:-UseLargePages")) {
+            hornet::gc_large_pages = false;
+            continue;
+        }
+        if (option_prefix(opt, "-Xmn", &value)) {
+            if (!parse_size(value, &hornet::gc_nursery_size) || hornet::gc_nursery_size < 1024) {
+                fprintf(stderr, "error: Invalid nursery size: '%s'\n", opt);
+                return JNI_ERR;
+            }
+            continue;
+        }
+        if (option_prefix(opt, "-XX:GCGenerations=", &value)) {
+            char* end;
+            auto generations = strtoul(value, &end, 10);
+            if (end == value || *end || generations < 1 || generations > hornet::gc_max_generations) {
+                fprintf(stderr, "error: Number of generations must be between 1 and %u: '%s'\n", hornet::gc_max_generations, opt);
+                return JNI_ERR;
+            }
+            hornet::gc_generations = generations;
+            continue;
+        }
+        if (option_prefix(opt, "-XX:NurseryMortality=", &value)) {
+            if (!parse_mortality(value, &hornet::gc_nursery_mortality)) {
+                fprintf(stderr, "error: Mortality must be between 0 and 1: '%s'\n", opt);
+                return JNI_ERR;
+            }
+            continue;
+        }
+        if (option_prefix(opt, "-XX:MatureMortality=", &value)) {
+            if (!parse_mortality(value, &hornet::gc_mature_mortality)) {
+                fprintf(stderr, "error: Mortality must be between 0 and 1: '%s'\n", opt);
+                return JNI_ERR;
+            }
+            continue;
+        }
         if (option_matches(opt, "-XX:+DynASM")) {
 #ifdef CONFIG_HAVE_DYNASM
             backend = hornet::backend_type::dynasm;
@@ -157,6 +324,11 @@ jint JNI_CreateJavaVM(JavaVM **vm, void **penv, void *args)
         return JNI_ERR;
     }
 
+    if (initial_heap_size_set && hornet::gc_max_heap_size && hornet::gc_initial_heap_size > hornet::gc_max_heap_size) {
+        fprintf(stderr, "error: Initial heap size is larger than the maximum heap size.\n");
+        return JNI_ERR;
+    }
+
     switch (backend) {
     case hornet::backend_type::interp:
         hornet::_backend = new hornet::interp_backend();
@@ -235,7 +407,7 @@ static void HORNET_JNI(CallStaticVoidMethodV)(JNIEnv *env, jclass clazz, jmethod
 
     auto thread = hornet::thread::current();
 
-    auto frame = thread->make_frame(method->max_locals);
+    auto frame = thread->make_frame(method);
 
     for (int i = 0; i < method->args_count; i++) {
         frame->locals[i] = va_arg(args, uint64_t);
@@ -259,7 +431,7 @@ static void HORNET_JNI(CallStaticVoidMethod)(JNIEnv *env, jclass clazz, jmethodI
 
 static jstring HORNET_JNI(NewStringUTF)(JNIEnv* env, const char* bytes)
 {
-    auto string = hornet::_jvm->intern_string(std::string{bytes});
+    auto string = hornet::gc_new_string(bytes, strlen(bytes));
 
     return hornet::to_jstring(string);
 }
@@ -269,12 +441,16 @@ static const char* HORNET_JNI(GetStringUTFChars)(JNIEnv* env, jstring string, jb
     if (!string) {
         return nullptr;
     }
-    auto str = hornet::from_jstring(string);
-    return str->data;
+    auto str = hornet::from_jstring(string)->to_utf8();
+    if (isCopy) {
+        *isCopy = JNI_TRUE;
+    }
+    return strdup(str.c_str());
 }
 
 static void HORNET_JNI(ReleaseStringUTFChars)(JNIEnv *env, jstring string, const char *utf)
 {
+    free(const_cast<char*>(utf));
 }
 
 static jobjectArray
@@ -284,11 +460,44 @@ HORNET_JNI(NewObjectArray)(JNIEnv* env, jsize len, jclass clazz, jobject init)
 
     assert(init == nullptr);
 
-    auto array = hornet::gc_new_object_array(klass, len);
+    auto array = hornet::gc_new_object_array(klass->array_class(), len);
 
     return hornet::to_jobjectArray(array);
 }
 
+static jsize HORNET_JNI(GetArrayLength)(JNIEnv* env, jarray array)
+{
+    return hornet::from_jarray(array)->length;
+}
+
+static jobject HORNET_JNI(GetObjectArrayElement)(JNIEnv* env, jobjectArray array, jsize index)
+{
+    auto arrayref = hornet::from_jarray(array);
+
+    return hornet::to_jobject(hornet::decode_heap_ref(arrayref->get<hornet::heap_ref>(index)));
+}
+
+static void HORNET_JNI(SetObjectArrayElement)(JNIEnv* env, jobjectArray array, jsize index, jobject value)
+{
+    auto arrayref = hornet::from_jarray(array);
+
+    arrayref->set<hornet::heap_ref>(index, hornet::encode_heap_ref(hornet::from_jobject(value)));
+}
+
+static jint HORNET_JNI(MonitorEnter)(JNIEnv* env, jobject obj)
+{
+    hornet::from_jobject(obj)->lock();
+
+    return JNI_OK;
+}
+
+static jint HORNET_JNI(MonitorExit)(JNIEnv* env, jobject obj)
+{
+    hornet::from_jobject(obj)->unlock();
+
+    return JNI_OK;
+}
+
 static jint HORNET_JNI(RegisterNatives)(JNIEnv* env, jclass clazz, const JNINativeMethod* methods, jint count)
 {
     WARN_STUB();
@@ -480,10 +689,10 @@ const struct JNINativeInterface_ HORNET_JNI(JNINativeInterface) = {
     HORNET_DEFINE_JNI_STUB(GetStringUTFLength),
     HORNET_DEFINE_JNI(GetStringUTFChars),
     HORNET_DEFINE_JNI(ReleaseStringUTFChars),
-    HORNET_DEFINE_JNI_STUB(GetArrayLength),
+    HORNET_DEFINE_JNI(GetArrayLength),
     HORNET_DEFINE_JNI(NewObjectArray),
-    HORNET_DEFINE_JNI_STUB(GetObjectArrayElement),
-    HORNET_DEFINE_JNI_STUB(SetObjectArrayElement),
+    HORNET_DEFINE_JNI(GetObjectArrayElement),
+    HORNET_DEFINE_JNI(SetObjectArrayElement),
     HORNET_DEFINE_JNI_STUB(NewBooleanArray),
     HORNET_DEFINE_JNI_STUB(NewByteArray),
     HORNET_DEFINE_JNI_STUB(NewCharArray),
@@ -526,8 +735,8 @@ const struct JNINativeInterface_ HORNET_JNI(JNINativeInterface) = {
     HORNET_DEFINE_JNI_STUB(SetDoubleArrayRegion),
     HORNET_DEFINE_JNI(RegisterNatives),
     HORNET_DEFINE_JNI_STUB(UnregisterNatives),
-    HORNET_DEFINE_JNI_STUB(MonitorEnter),
-    HORNET_DEFINE_JNI_STUB(MonitorExit),
+    HORNET_DEFINE_JNI(MonitorEnter),
+    HORNET_DEFINE_JNI(MonitorExit),
     HORNET_DEFINE_JNI_STUB(GetJavaVM),
     HORNET_DEFINE_JNI_STUB(GetStringRegion),
     HORNET_DEFINE_JNI_STUB(GetStringUTFRegion),
@@ -125,7 +125,7 @@ FunctionType* function_type(IRBuilder<>& builder, method* method)
 Function* function(IRBuilder<>& builder, method* method)
 {
     auto func_type = function_type(builder, method);
-    auto func = Function::Create(func_type, Function::ExternalLinkage, method->name, module);
+    auto func = Function::Create(func_type, Function::ExternalLinkage, method->name.str(), module);
     auto entry = BasicBlock::Create(builder.getContext(), "entry", func);
     builder.SetInsertPoint(entry);
     return func;
@@ -178,6 +178,18 @@ void llvm_translator::begin(std::shared_ptr<basic_block> bblock)
 
 void llvm_translator::op_const(type t, int64_t value)
 {
+    if (t == type::t_ref) {
+        auto ref_type = cast<PointerType>(typeof(t));
+        if (!value) {
+            _mimic_stack.push(ConstantPointerNull::get(ref_type));
+            return;
+        }
+        auto addr = ConstantInt::get(Type::getInt64Ty(getGlobalContext()), value, 0);
+        auto slot = _builder.CreateIntToPtr(addr, ref_type->getPointerTo());
+        _mimic_stack.push(_builder.CreateLoad(slot));
+        return;
+    }
+
     auto c = ConstantInt::get(typeof(t), value, 0);
 
     _mimic_stack.push(c);
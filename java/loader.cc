@@ -36,39 +36,126 @@ void loader::register_entry(std::string path)
     }
 }
 
-std::shared_ptr<klass> loader::load_class(std::string class_name)
+std::shared_ptr<klass> loader::load_class(const std::string& class_name)
 {
-    std::replace(class_name.begin(), class_name.end(), '.', '/');
+    if (class_name.find('.') == std::string::npos) {
+        return load_class(intern(class_name));
+    }
+    auto name = class_name;
+    std::replace(name.begin(), name.end(), '.', '/');
+    return load_class(intern(name));
+}
 
+std::shared_ptr<klass> loader::load_class(symbol class_name)
+{
     auto klass = hornet::_jvm->lookup_class(class_name);
     if (klass) {
         return klass;
     }
+    {
+        std::unique_lock<std::mutex> lock(_loading_mutex);
+        for (;;) {
+            klass = hornet::_jvm->lookup_class(class_name);
+            if (klass) {
+                return klass;
+            }
+            if (!_loading.count(class_name)) {
+                break;
+            }
+            // Only superclasses, interfaces and array element types are
+            // loaded while a class is loading, so waiting for a class that
+            // waits for this thread means the class is its own superclass.
+            if (waits_for_self(class_name)) {
+                hornet::throw_exception(java_lang_NoClassDefFoundError);
+                return nullptr;
+            }
+            _waiting.emplace(std::this_thread::get_id(), class_name);
+            _loading_done.wait(lock);
+            _waiting.erase(std::this_thread::get_id());
+        }
+        _loading.emplace(class_name, std::this_thread::get_id());
+    }
+    klass = define_class(class_name);
+    {
+        std::lock_guard<std::mutex> lock(_loading_mutex);
+        _loading.erase(class_name);
+    }
+    _loading_done.notify_all();
+    if (!klass) {
+        return nullptr;
+    }
+    // Verification resolves classes, so it runs once the class is published.
+    if (!klass->verify()) {
+        throw_exception(java_lang_VerifyError);
+        return nullptr;
+    }
+    return klass;
+}
 
-    if (is_array_type_name(class_name)) {
-        auto elem_type_name = class_name.substr(1, std::string::npos);
-        auto elem_type = load_class(elem_type_name);
+// Returns true if the thread loading a class is this thread or waits for it,
+// directly or through other loading threads.
+bool loader::waits_for_self(symbol class_name) const
+{
+    auto self = std::this_thread::get_id();
+    auto it = _loading.find(class_name);
+    while (it != _loading.end()) {
+        auto owner = it->second;
+        if (owner == self) {
+            return true;
+        }
+        auto waiting = _waiting.find(owner);
+        if (waiting == _waiting.end()) {
+            return false;
+        }
+        it = _loading.find(waiting->second);
+    }
+    return false;
+}
+
+std::shared_ptr<klass> loader::define_class(symbol class_name)
+{
+    if (is_array_type_name(class_name.str())) {
+        auto elem_type_name = class_name.str().substr(1, std::string::npos);
+        std::shared_ptr<hornet::klass> elem_type;
+        switch (elem_type_name[0]) {
+        case 'L':
+            elem_type = load_class(elem_type_name.substr(1, elem_type_name.size() - 2));
+            break;
+        case '[':
+            elem_type = load_class(elem_type_name);
+            break;
+        default:
+            elem_type = prim_sig_to_klass(elem_type_name[0]);
+            break;
+        }
         if (!elem_type) {
             hornet::throw_exception(java_lang_NoClassDefFoundError);
             return nullptr;
         }
-        auto klass = std::make_shared<array_klass>(class_name, elem_type.get());
-        hornet::_jvm->register_class(klass);
-        return klass;
+        auto klass = std::make_shared<array_klass>(class_name.str(), elem_type.get());
+        // Arrays inherit the methods of java/lang/Object.
+        auto object_klass = hornet::_jvm->lookup_class("java/lang/Object");
+        if (object_klass) {
+            klass->super = object_klass.get();
+        }
+        for (auto* iface_name : {"java/lang/Cloneable", "java/io/Serializable"}) {
+            auto iface = load_class(iface_name);
+            if (!iface) {
+                return nullptr;
+            }
+            klass->add(iface.get());
+        }
+        klass->link();
+        return hornet::_jvm->register_class(klass);
     }
 
-    klass = try_to_load_class(class_name);
+    auto klass = try_to_load_class(class_name.str());
 
     if (!klass) {
         hornet::throw_exception(java_lang_NoClassDefFoundError);
         return nullptr;
     }
 
-    if (!klass->verify()) {
-        throw_exception(java_lang_VerifyError);
-        return nullptr;
-    }
-
     return klass;
 }
 
@@ -44,6 +44,8 @@ next_insn:
 
     uint8_t opc = _method->code[pc];
 
+    _insn_pc = pc;
+
     switch (opc) {
     case JVM_OPC_nop:
         break;
@@ -699,25 +701,25 @@ next_insn:
     case JVM_OPC_getstatic: {
         uint16_t idx = read_opc_u2(_method->code + pc);
         auto field = _method->klass->resolve_field(idx);
-        op_getstatic(field.get());
+        op_getstatic(field);
         break;
     }
     case JVM_OPC_putstatic: {
         uint16_t idx = read_opc_u2(_method->code + pc);
         auto field = _method->klass->resolve_field(idx);
-        op_putstatic(field.get());
+        op_putstatic(field);
         break;
     }
     case JVM_OPC_getfield: {
         uint16_t idx = read_opc_u2(_method->code + pc);
         auto field = _method->klass->resolve_field(idx);
-        op_getfield(field.get());
+        op_getfield(field);
         break;
     }
     case JVM_OPC_putfield: {
         uint16_t idx = read_opc_u2(_method->code + pc);
         auto field = _method->klass->resolve_field(idx);
-        op_putfield(field.get());
+        op_putfield(field);
         break;
     }
     case JVM_OPC_invokevirtual: {
@@ -725,7 +727,7 @@ next_insn:
         auto target = _method->klass->resolve_method(idx);
         assert(target != nullptr);
         assert(!(target->access_flags & JVM_ACC_STATIC));
-        op_invokevirtual(target.get());
+        op_invokevirtual(target);
         break;
     }
     case JVM_OPC_invokespecial: {
@@ -735,10 +737,10 @@ next_insn:
         if (_method->klass->access_flags & JVM_ACC_SUPER
                 && _method->klass->super->is_subclass_of(target->klass)
                 && !target->is_init()) {
-            target = _method->klass->super->lookup_method(target->name, target->descriptor);
+            target = _method->klass->super->lookup_method(target->name, target->descriptor).get();
             assert(target != nullptr);
         }
-        op_invokespecial(target.get());
+        op_invokespecial(target);
         break;
     }
     case JVM_OPC_invokestatic: {
@@ -746,7 +748,7 @@ next_insn:
         auto target = _method->klass->resolve_method(idx);
         assert(target != nullptr);
         assert(target->access_flags & JVM_ACC_STATIC);
-        op_invokestatic(target.get());
+        op_invokestatic(target);
         break;
     }
     case JVM_OPC_invokeinterface: {
@@ -757,14 +759,14 @@ next_insn:
         assert(zero == 0);
         auto target = _method->klass->resolve_interface_method(idx);
         assert(target != nullptr);
-        op_invokeinterface(target.get());
+        op_invokeinterface(target);
         break;
     }
     case JVM_OPC_new: {
         uint16_t idx = read_opc_u2(_method->code + pc);
         auto klass = _method->klass->resolve_class(idx);
         assert(klass != nullptr);
-        op_new(klass.get());
+        op_new(klass);
         break;
     }
     case JVM_OPC_newarray: {
@@ -776,7 +778,7 @@ next_insn:
         uint16_t idx = read_opc_u2(_method->code + pc);
         auto klass = _method->klass->resolve_class(idx);
         assert(klass != nullptr);
-        op_anewarray(klass.get());
+        op_anewarray(klass);
         break;
     }
     case JVM_OPC_arraylength: {
@@ -791,14 +793,14 @@ next_insn:
         uint16_t idx = read_opc_u2(_method->code + pc);
         auto klass = _method->klass->resolve_class(idx);
         assert(klass != nullptr);
-        op_checkcast(klass.get());
+        op_checkcast(klass);
         break;
     }
     case JVM_OPC_instanceof: {
         uint16_t idx = read_opc_u2(_method->code + pc);
         auto klass = _method->klass->resolve_class(idx);
         assert(klass != nullptr);
-        op_instanceof(klass.get());
+        op_instanceof(klass);
         break;
     }
     case JVM_OPC_monitorenter: {
@@ -814,7 +816,7 @@ next_insn:
         uint8_t dimensions = read_opc_u2(_method->code + pc + sizeof(uint16_t));
         auto klass = _method->klass->resolve_class(idx);
         assert(klass != nullptr);
-        op_multianewarray(klass.get(), dimensions);
+        op_multianewarray(klass, dimensions);
         break;
     }
     case JVM_OPC_ifnull: {
@@ -856,8 +858,8 @@ void translator::ldc(uint16_t idx)
         break;
     }
     case cp_tag::const_string: {
-        auto value = const_pool->get_string(idx);
-        op_const(type::t_ref, reinterpret_cast<int64_t>(value));
+        auto slot = _method->klass->resolve_string(idx);
+        op_const(type::t_ref, reinterpret_cast<int64_t>(slot));
         break;
     }
     case cp_tag::const_integer: {
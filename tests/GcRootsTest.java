@@ -0,0 +1,51 @@
+/*
+ * Keeps objects reachable only from local variables, the operand stack,
+ * static fields and string literals while the GC moves them.
+ */
+public class GcRootsTest {
+  static class Node {
+    int value;
+    Node next;
+
+    Node(int value, Node next) {
+      this.value = value;
+      this.next = next;
+    }
+  }
+
+  static Node head;
+  static String name;
+
+  static void churn() {
+    for (int i = 0; i < 20000; i++) {
+      int[] garbage = new int[16];
+      garbage[0] = i;
+    }
+  }
+
+  static int sum(Node node) {
+    int result = 0;
+    while (node != null) {
+      result += node.value;
+      node = node.next;
+    }
+    return result;
+  }
+
+  public static void main(String[] args) {
+    Node list = null;
+    for (int i = 0; i < 100; i++) {
+      list = new Node(i, list);
+    }
+    head = list;
+    name = "roots";
+    int total = 0;
+    for (int i = 0; i < 100; i++) {
+      churn();
+      total += sum(list);
+    }
+    if (total != 100 * 4950 || head != list || name != "roots") {
+      throw new RuntimeException("lost a root");
+    }
+  }
+}
@@ -0,0 +1,23 @@
+public class InvokeBench {
+  private int value;
+
+  public InvokeBench(int value) {
+    this.value = value;
+  }
+
+  public int get() {
+    return value;
+  }
+
+  public static int add(int a, int b) {
+    return a + b;
+  }
+
+  public static void main(String[] args) {
+    InvokeBench bench = new InvokeBench(1);
+    int result = 0;
+    for (int i = 0; i < 10000000; i++) {
+      result = add(result, bench.get());
+    }
+  }
+}
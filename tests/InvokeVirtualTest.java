@@ -0,0 +1,38 @@
+public class InvokeVirtualTest {
+  interface Shape {
+    int area();
+  }
+
+  static class Square implements Shape {
+    public int area() { return 4; }
+  }
+
+  static class Rectangle implements Shape {
+    public int area() { return 6; }
+  }
+
+  static class Triangle implements Shape {
+    public int area() { return 3; }
+  }
+
+  static class Circle implements Shape {
+    public int area() { return 12; }
+  }
+
+  static class Point implements Shape {
+    public int area() { return 0; }
+  }
+
+  public static void main(String[] args) {
+    Shape[] shapes = new Shape[] {
+      new Square(), new Rectangle(), new Triangle(), new Circle(), new Point()
+    };
+    int result = 0;
+    for (int i = 0; i < 1000; i++) {
+      // Monomorphic, polymorphic and megamorphic call sites.
+      result += shapes[0].area();
+      result += shapes[i % 2].area();
+      result += shapes[i % shapes.length].area();
+    }
+  }
+}
@@ -0,0 +1,71 @@
+/*
+ * Checks instanceof and checkcast against classes, interfaces, hierarchies
+ * deeper than the primary supers display, and arrays.
+ */
+public class SubtypeTest {
+  interface Named {}
+  interface Labeled extends Named {}
+
+  static class L0 {}
+  static class L1 extends L0 {}
+  static class L2 extends L1 {}
+  static class L3 extends L2 {}
+  static class L4 extends L3 {}
+  static class L5 extends L4 {}
+  static class L6 extends L5 {}
+  static class L7 extends L6 implements Labeled {}
+  static class L8 extends L7 {}
+  static class L9 extends L8 {}
+  static class L10 extends L9 {}
+  static class Other {}
+
+  static void check(boolean condition) {
+    if (!condition) {
+      throw new RuntimeException("wrong subtype check");
+    }
+  }
+
+  public static void main(String[] args) {
+    Object deep = new L10();
+    check(deep instanceof L0);
+    check(deep instanceof L7);
+    check(deep instanceof L9);
+    check(deep instanceof L10);
+    check(deep instanceof Named);
+    check(deep instanceof Labeled);
+    check(!(deep instanceof Other));
+
+    Object shallow = new L8();
+    check(shallow instanceof L8);
+    check(!(shallow instanceof L9));
+    check(!(shallow instanceof L10));
+    check(!(new L6() instanceof Named));
+    check(!(new Other() instanceof L0));
+
+    Object nothing = null;
+    check(!(nothing instanceof Object));
+
+    L0 cast = (L0) deep;
+    Named named = (Named) deep;
+    L10 same = (L10) cast;
+    check(same == named);
+
+    Object strings = new String[1];
+    check(strings instanceof Object[]);
+    check(strings instanceof Cloneable);
+    check(strings instanceof java.io.Serializable);
+    check(!(strings instanceof Integer[]));
+    Object[] objects = (Object[]) strings;
+    check(objects.length == 1);
+
+    Object levels = new L10[1][1];
+    check(levels instanceof L0[][]);
+    check(levels instanceof Named[][]);
+    check(levels instanceof Object[]);
+    check(!(levels instanceof L0[]));
+
+    Object ints = new int[1];
+    check(ints instanceof Cloneable);
+    check(!(ints instanceof Object[]));
+  }
+}
@@ -1,15 +1,23 @@
 #include "hornet/vm.hh"
 
 #include "hornet/java.hh"
+#include "hornet/os.hh"
 
 extern "C" {
 #include "../mps/mps.h"
 #include "../mps/mpsavm.h"
+#include "../mps/mpsacl.h"
 #include "../mps/mpscamc.h"
 }
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <unistd.h>
 
 namespace hornet {
 
@@ -19,80 +27,434 @@ void out_of_memory()
     abort();
 }
 
-static mps_ap_t obj_ap;
+// The defaults are the MPS default chain: an 8 MB nursery and a 32 MB second
+// generation, after which objects go to the dynamic generation.
+size_t gc_nursery_size = 8 * 1024 * 1024;
+unsigned gc_generations = 2;
+double gc_nursery_mortality = 0.85;
+double gc_mature_mortality = 0.45;
+bool print_gc_stats;
 
-object* gc_new_object(klass* klass)
+static mps_arena_t arena;
+static mps_chain_t obj_chain;
+static mps_pool_t obj_pool;
+
+// The pool requires object sizes to be multiples of the format alignment.
+static size_t align_size(size_t size)
 {
-    size_t size = sizeof(object);
+    return (size + alignof(object) - 1) & ~(alignof(object) - 1);
+}
+
+mps_ap_s* gc_create_alloc_point()
+{
+    mps_ap_t ap;
+    mps_res_t res = mps_ap_create_k(&ap, obj_pool, mps_args_none);
+    if (res != MPS_RES_OK)
+        assert(0);
+    return ap;
+}
+
+void gc_destroy_alloc_point(mps_ap_s* ap)
+{
+    mps_ap_destroy(ap);
+}
+
+static mps_addr_t gc_alloc(size_t size)
+{
+    auto obj_ap = thread::current()->alloc_point();
     mps_addr_t addr;
     do {
         mps_res_t res = mps_reserve(&addr, obj_ap, size);
         if (res != MPS_RES_OK)
-            assert(0);
+            out_of_memory();
+        memset(addr, 0, size);
     } while (!mps_commit(obj_ap, addr, size));
+    return addr;
+}
+
+object* gc_new_object(klass* klass)
+{
+    auto addr = gc_alloc(align_size(klass->instance_size));
     return new (addr) object{klass};
 }
 
-array* gc_new_object_array(klass* klass, size_t length)
+array* gc_new_object_array(klass* array_klass, size_t length)
 {
-    size_t size = sizeof(array) + length * klass->size();
-    mps_addr_t addr;
-    do {
-        mps_res_t res = mps_reserve(&addr, obj_ap, size);
-        if (res != MPS_RES_OK)
-            assert(0);
-    } while (!mps_commit(obj_ap, addr, size));
-    return new (addr) array{klass, static_cast<uint32_t>(length)};
+    auto elem_size = static_cast<struct array_klass*>(array_klass)->elem_size;
+    auto addr = gc_alloc(align_size(sizeof(array) + length * elem_size));
+    return new (addr) array{array_klass, static_cast<uint32_t>(length)};
+}
+
+string* gc_new_string(const char* utf8, size_t size)
+{
+    string_coder coder;
+    auto length = string::utf8_length(utf8, size, coder);
+    auto addr = gc_alloc(align_size(string::size(length, coder)));
+    auto str = new (addr) string{length, coder};
+    str->decode_utf8(utf8, size);
+    return str;
 }
 
 static void obj_pad(mps_addr_t addr, size_t size)
 {
-    // XXX: padding objects?
-    assert(0);
+    object::make_padding(addr, size);
 }
 
 static mps_addr_t obj_isfwd(mps_addr_t addr)
 {
     auto obj = static_cast<object*>(addr);
 
-    return static_cast<mps_addr_t>(obj->fwd);
+    return static_cast<mps_addr_t>(obj->forwardee());
+}
+
+static size_t obj_size(object* obj);
+
+// MPS has no interface for inspecting generations, so the statistics are
+// gathered when objects are copied. An object is copied once per generation
+// it survives, which makes its age the generation it is copied out of. The
+// last generation is the dynamic one that the chain ends in, and survivors
+// of its collections stay in it.
+struct generation_stats {
+    uint64_t collections;
+    mps_word_t last_collection;
+    uint64_t survivors;
+    uint64_t survivor_bytes;
+};
+
+static generation_stats gen_stats[gc_max_generations + 1];
+
+// Called with the arena locked, so the counters need no synchronization.
+static void record_survivor(object* obj)
+{
+    auto gen = std::min(obj->age(), gc_generations);
+    auto& stats = gen_stats[gen];
+    // Every collection condemns the nursery, but older generations are only
+    // condemned once the generations below them fill up. A collection is
+    // counted for an older generation when it copies the first object out of
+    // it, so collections without survivors are missed.
+    auto collection = mps_collections(arena);
+    if (!stats.collections || stats.last_collection != collection) {
+        stats.collections++;
+        stats.last_collection = collection;
+    }
+    stats.survivors++;
+    stats.survivor_bytes += obj_size(obj);
 }
 
 static void obj_fwd(mps_addr_t old, mps_addr_t new_)
 {
     auto obj = static_cast<object*>(old);
 
-    obj->fwd = static_cast<object*>(new_);
+    if (print_gc_stats) {
+        record_survivor(obj);
+    }
+
+    static_cast<object*>(new_)->increment_age();
+
+    obj->forward_to(static_cast<object*>(new_));
 }
 
-static mps_res_t obj_scan(mps_ss_t ss, mps_addr_t base, mps_addr_t limit)
+// Returns the size of an object, which may also be a forwarded object whose
+// mark word has been overwritten.
+static size_t obj_size(object* obj)
 {
-    // XXX: objects have no fields
-    // XXX: arrays need to be scanned
+    auto klass = obj->klass();
+    switch (klass->layout) {
+    case layout_kind::instance:
+        if (klass == java_lang_String.get() && obj->is_vm_string()) {
+            auto str = reinterpret_cast<string*>(obj);
+            return align_size(string::size(str->length(), str->coder()));
+        }
+        return align_size(klass->instance_size);
+    case layout_kind::object_array:
+    case layout_kind::primitive_array: {
+        auto arr = reinterpret_cast<array*>(obj);
+        return align_size(sizeof(array) + arr->length * static_cast<array_klass*>(klass)->elem_size);
+    }
+    }
     assert(0);
+    return 0;
+}
+
+// Fixes the reference in a heap slot. MPS_FIX1 and MPS_FIX2 refer to the scan
+// state that MPS_SCAN_BEGIN sets up, so this is a macro.
+#define FIX_HEAP_REF(slot)                                              \
+    do {                                                                \
+        mps_addr_t ref = decode_heap_ref(*(slot));                      \
+        if (ref && MPS_FIX1(ss, ref)) {                                 \
+            mps_res_t res = MPS_FIX2(ss, &ref);                         \
+            if (res != MPS_RES_OK)                                      \
+                return res;                                             \
+            *(slot) = encode_heap_ref(static_cast<object*>(ref));       \
+        }                                                               \
+    } while (0)
+
+static mps_res_t obj_scan(mps_ss_t ss, mps_addr_t base, mps_addr_t limit)
+{
+    MPS_SCAN_BEGIN(ss) {
+        while (base < limit) {
+            auto obj = static_cast<object*>(base);
+            if (auto size = obj->padding_size()) {
+                base = static_cast<char*>(base) + size;
+                continue;
+            }
+            auto klass = obj->klass();
+            if (obj->forwardee()) {
+                // The copy is scanned instead.
+            } else if (klass->layout == layout_kind::instance) {
+                // VM strings have the reference fields of java/lang/String
+                // before their payload.
+                auto* slots = reinterpret_cast<heap_ref*>(obj);
+                auto* map = klass->oop_map.data();
+                for (size_t word = 0; word < klass->oop_map.size(); word++) {
+                    for (auto bits = map[word]; bits; bits &= bits - 1) {
+                        FIX_HEAP_REF(&slots[word * 64 + __builtin_ctzll(bits)]);
+                    }
+                }
+            } else if (klass->layout == layout_kind::object_array) {
+                auto arr = reinterpret_cast<array*>(obj);
+                auto* slots = reinterpret_cast<heap_ref*>(arr->data);
+                for (uint32_t idx = 0; idx < arr->length; idx++) {
+                    FIX_HEAP_REF(&slots[idx]);
+                }
+            }
+            base = static_cast<char*>(base) + obj_size(obj);
+        }
+    } MPS_SCAN_END(ss);
     return MPS_RES_OK;
 }
 
 static mps_addr_t obj_skip(mps_addr_t base)
 {
-    auto end = static_cast<char*>(base) + sizeof(object);
+    auto obj = static_cast<object*>(base);
+    if (auto size = obj->padding_size()) {
+        return static_cast<char*>(base) + size;
+    }
+    return static_cast<char*>(base) + obj_size(obj);
+}
+
+// Fixes the reference in a root slot. Roots are outside the heap and always
+// hold full pointers.
+#define FIX_ROOT(slot)                                                  \
+    do {                                                                \
+        auto* root = reinterpret_cast<mps_addr_t*>(slot);               \
+        if (*root && MPS_FIX1(ss, *root)) {                             \
+            mps_res_t res = MPS_FIX2(ss, root);                         \
+            if (res != MPS_RES_OK)                                      \
+                return res;                                             \
+        }                                                               \
+    } while (0)
+
+static mps_res_t klass_scan(mps_ss_t ss, klass* klass)
+{
+    MPS_SCAN_BEGIN(ss) {
+        FIX_ROOT(&klass->object);
+        auto* slots = klass->static_values.data();
+        auto* map = klass->static_oop_map.data();
+        for (size_t word = 0; word < klass->static_oop_map.size(); word++) {
+            for (auto bits = map[word]; bits; bits &= bits - 1) {
+                FIX_ROOT(&slots[word * 64 + __builtin_ctzll(bits)]);
+            }
+        }
+    } MPS_SCAN_END(ss);
+    return MPS_RES_OK;
+}
 
-    return static_cast<mps_addr_t>(end);
+static mps_res_t string_slot_scan(mps_ss_t ss, string** slot)
+{
+    MPS_SCAN_BEGIN(ss) {
+        FIX_ROOT(slot);
+    } MPS_SCAN_END(ss);
+    return MPS_RES_OK;
 }
 
+// Class mirrors, static fields and interned strings.
 static mps_res_t globals_scan(mps_ss_t ss, void *p, size_t s)
 {
-    assert(0);
+    mps_res_t res = MPS_RES_OK;
+    _jvm->for_each_class([&](klass* klass) {
+        if (res == MPS_RES_OK) {
+            res = klass_scan(ss, klass);
+        }
+    });
+    _jvm->for_each_interned_string([&](string** slot) {
+        if (res == MPS_RES_OK) {
+            res = string_slot_scan(ss, slot);
+        }
+    });
+    return res;
 }
 
-void gc_init()
+// Fixes the references in the frames of a thread. Every frame is stopped at a
+// GC point, where the interpreter has spilled the operand stack to memory, and
+// only the slots that the GC map of the point marks as references are fixed.
+static mps_res_t thread_scan(mps_ss_t ss, void *p, size_t s)
+{
+    auto* thread = static_cast<struct thread*>(p);
+    MPS_SCAN_BEGIN(ss) {
+        FIX_ROOT(&thread->exception);
+        for (auto* frame = thread->top_frame(); frame; frame = frame->prev) {
+            auto* method = frame->method;
+            if (!frame->pc) {
+                // Not at a GC point yet, so only the arguments are live.
+                size_t idx = 0;
+                if (!(method->access_flags & JVM_ACC_STATIC)) {
+                    FIX_ROOT(&frame->locals[idx++]);
+                }
+                for (auto arg_type : method->arg_types) {
+                    if (arg_type == type::t_ref) {
+                        FIX_ROOT(&frame->locals[idx]);
+                    }
+                    auto wide = arg_type == type::t_long || arg_type == type::t_double;
+                    idx += wide ? 2 : 1;
+                }
+                continue;
+            }
+            auto it = method->gc_maps.find(frame->pc);
+            if (it == method->gc_maps.end()) {
+                fprintf(stderr, "error: no GC map for %s at pc %u\n", method->full_name().c_str(), static_cast<unsigned>(frame->pc));
+                abort();
+            }
+            auto& map = it->second;
+            // Arguments of a call in progress have been popped off the operand
+            // stack and belong to the callee frame.
+            size_t nr_slots = method->max_locals + (frame->sp - frame->ostack);
+            for (size_t word = 0; word < map.size(); word++) {
+                for (auto bits = map[word]; bits; bits &= bits - 1) {
+                    auto idx = word * 64 + __builtin_ctzll(bits);
+                    if (idx >= nr_slots) {
+                        break;
+                    }
+                    if (idx < method->max_locals) {
+                        FIX_ROOT(&frame->locals[idx]);
+                    } else {
+                        FIX_ROOT(&frame->ostack[idx - method->max_locals]);
+                    }
+                }
+            }
+        }
+    } MPS_SCAN_END(ss);
+    return MPS_RES_OK;
+}
+
+mps_thr_s* gc_register_thread()
+{
+    mps_thr_t thr;
+    mps_res_t res = mps_thread_reg(&thr, arena);
+    if (res != MPS_RES_OK)
+        assert(0);
+    return thr;
+}
+
+void gc_deregister_thread(mps_thr_s* thr)
+{
+    mps_thread_dereg(thr);
+}
+
+mps_root_s* gc_create_thread_root(thread* thread)
+{
+    mps_root_t root;
+    mps_res_t res = mps_root_create(&root, arena, mps_rank_exact(), 0, thread_scan, thread, 0);
+    if (res != MPS_RES_OK)
+        assert(0);
+    return root;
+}
+
+void gc_destroy_thread_root(mps_root_s* root)
+{
+    mps_root_destroy(root);
+}
+
+size_t gc_initial_heap_size = 32 * 1024 * 1024;
+size_t gc_max_heap_size;
+bool gc_large_pages;
+
+#ifdef CONFIG_COMPRESSED_OOPS
+char* heap_base;
+#endif
+
+static size_t default_max_heap_size()
+{
+    auto size = static_cast<size_t>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGESIZE) / 4;
+#ifdef CONFIG_COMPRESSED_OOPS
+    size = std::min(size, max_compressed_heap_size);
+#endif
+    return std::max(size, gc_initial_heap_size);
+}
+
+// Reserves address space for the whole heap. Memory is committed as the GC
+// touches it. Transparent huge pages only back 2 MB aligned ranges, so with
+// large pages the reservation is aligned to a huge page.
+static char* reserve_heap(size_t size)
+{
+    size_t align = gc_large_pages ? hugepage_size : 0;
+    auto* p = mmap(nullptr, size + align, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON|MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        out_of_memory();
+    }
+    auto* base = static_cast<char*>(p);
+    if (!align) {
+        return base;
+    }
+    auto* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(base) + align - 1) & ~(align - 1));
+    if (aligned != base) {
+        munmap(base, aligned - base);
+    }
+    munmap(aligned + size, base + align - aligned);
+    if (madvise(aligned, size, MADV_HUGEPAGE) < 0) {
+        fprintf(stderr, "warning: large pages are not available: %s\n", strerror(errno));
+    }
+    return aligned;
+}
+
+// A virtual memory arena maps more address space as the heap grows, but it
+// maps it wherever it likes. Compressed references need the whole heap at a
+// known base, and large pages need to advise the kernel about the mapping,
+// so in those cases the heap is reserved up front and handed to a client
+// arena instead.
+static mps_res_t create_arena(mps_arena_t* arena)
 {
-    static mps_arena_t arena;
     mps_res_t res;
+#ifndef CONFIG_COMPRESSED_OOPS
+    if (!gc_large_pages) {
+        MPS_ARGS_BEGIN(args) {
+            MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, gc_initial_heap_size);
+            res = mps_arena_create_k(arena, mps_arena_class_vm(), args);
+        } MPS_ARGS_END(args);
+        return res;
+    }
+#endif
+    auto* base = reserve_heap(gc_max_heap_size);
+#ifdef CONFIG_COMPRESSED_OOPS
+    heap_base = base;
+#endif
     MPS_ARGS_BEGIN(args) {
-        MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, 32 * 1024 * 1024);
-        res = mps_arena_create_k(&arena, mps_arena_class_vm(), args);
+        MPS_ARGS_ADD(args, MPS_KEY_ARENA_CL_BASE, base);
+        MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, gc_max_heap_size);
+        res = mps_arena_create_k(arena, mps_arena_class_cl(), args);
     } MPS_ARGS_END(args);
+    return res;
+}
+
+void gc_init()
+{
+    if (!gc_max_heap_size) {
+        gc_max_heap_size = default_max_heap_size();
+    }
+    // A maximum below the default initial size shrinks the initial size.
+    gc_initial_heap_size = std::min(gc_initial_heap_size, gc_max_heap_size);
+    if (gc_large_pages) {
+        gc_max_heap_size = (gc_max_heap_size + hugepage_size - 1) & ~(hugepage_size - 1);
+    }
+#ifdef CONFIG_COMPRESSED_OOPS
+    assert(gc_max_heap_size <= max_compressed_heap_size);
+#endif
+
+    mps_res_t res = create_arena(&arena);
+    if (res != MPS_RES_OK)
+        assert(0);
+
+    res = mps_arena_commit_limit_set(arena, gc_max_heap_size);
     if (res != MPS_RES_OK)
         assert(0);
 
@@ -109,16 +471,23 @@ void gc_init()
     if (res != MPS_RES_OK)
         assert(0);
 
-    mps_pool_t obj_pool;
+    assert(gc_generations > 0 && gc_generations <= gc_max_generations);
+    mps_gen_param_s gen_params[gc_max_generations];
+    size_t capacity = gc_nursery_size / 1024;
+    for (unsigned gen = 0; gen < gc_generations; gen++) {
+        gen_params[gen].mps_capacity = capacity;
+        gen_params[gen].mps_mortality = gen ? gc_mature_mortality : gc_nursery_mortality;
+        capacity *= gc_generation_growth;
+    }
+    res = mps_chain_create(&obj_chain, arena, gc_generations, gen_params);
+    if (res != MPS_RES_OK)
+        assert(0);
+
     MPS_ARGS_BEGIN(args) {
         MPS_ARGS_ADD(args, MPS_KEY_FORMAT, obj_fmt);
+        MPS_ARGS_ADD(args, MPS_KEY_CHAIN, obj_chain);
         res = mps_pool_create_k(&obj_pool, arena, mps_class_amc(), args);
     } MPS_ARGS_END(args);
-    if (res != MPS_RES_OK)
-        assert(0);
-
-    res = mps_ap_create_k(&obj_ap, obj_pool, mps_args_none);
-
     if (res != MPS_RES_OK)
         assert(0);
 
@@ -128,4 +497,32 @@ void gc_init()
         assert(0);
 }
 
+void gc_stats()
+{
+    if (!print_gc_stats) {
+        return;
+    }
+    fprintf(stderr, "GC statistics:\n");
+    fprintf(stderr, "  Generation  Capacity (KB)  Collections   Survivors  Survived (KB)  Promoted (KB/collection)\n");
+    size_t capacity = gc_nursery_size / 1024;
+    for (unsigned gen = 0; gen <= gc_generations; gen++) {
+        auto& stats = gen_stats[gen];
+        auto collections = gen ? stats.collections : mps_collections(arena);
+        auto survived_kb = stats.survivor_bytes / 1024.0;
+        // Survivors of the dynamic generation stay in it.
+        auto promoted_kb = gen < gc_generations ? survived_kb : 0.0;
+        auto promotion_rate = collections ? promoted_kb / collections : 0.0;
+        if (gen < gc_generations) {
+            fprintf(stderr, "  %10u  %13zu", gen, capacity);
+        } else {
+            fprintf(stderr, "  %10s  %13s", "dynamic", "-");
+        }
+        fprintf(stderr, "  %11lu  %10lu  %13.1f  %24.1f\n",
+                static_cast<unsigned long>(collections),
+                static_cast<unsigned long>(stats.survivors),
+                survived_kb, promotion_rate);
+        capacity *= gc_generation_growth;
+    }
+}
+
 }
@@ -0,0 +1,62 @@
+#include "hornet/class_dictionary.hh"
+
+#include "hornet/vm.hh"
+
+namespace hornet {
+
+// Symbols are unique, so keys are hashed and compared by pointer. Classes are
+// registered rarely compared to how often they are looked up, so all inserts
+// take a single lock.
+
+// Symbols hash to their address, whose low bits are always zero, so mix the
+// high bits in before masking.
+static size_t hash_symbol(symbol name)
+{
+    return (static_cast<uint64_t>(name.hash()) * 0x9e3779b97f4a7c15ull) >> 32;
+}
+
+size_t class_dictionary::entry_traits::hash(const entry& e)
+{
+    return hash_symbol(e.name);
+}
+
+class_dictionary::class_dictionary(size_t capacity)
+    : _table(capacity)
+{
+}
+
+class_dictionary::~class_dictionary()
+{
+}
+
+std::shared_ptr<klass> class_dictionary::lookup(symbol name) const
+{
+    auto* found = _table.find(hash_symbol(name), [&](const entry& e) { return e.name == name; });
+    if (!found) {
+        return nullptr;
+    }
+    return found->value;
+}
+
+std::shared_ptr<klass> class_dictionary::insert(symbol name, std::shared_ptr<klass> klass)
+{
+    std::lock_guard<std::mutex> lock(_insert_mutex);
+    auto hash = hash_symbol(name);
+    auto* found = _table.find(hash, [&](const entry& e) { return e.name == name; });
+    if (found) {
+        return found->value;
+    }
+    auto size = _table.add(hash, new entry{name, klass});
+    // Keep the load factor below 1/2 so that lookups rarely probe.
+    if (size * 2 > _table.capacity()) {
+        _table.grow();
+    }
+    return klass;
+}
+
+void class_dictionary::for_each(const std::function<void(klass*)>& fn) const
+{
+    _table.for_each([&](entry* e) { fn(e->value.get()); });
+}
+
+}
@@ -0,0 +1,116 @@
+#include "hornet/intern_table.hh"
+
+#include "hornet/vm.hh"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace hornet {
+
+// Inserting a string takes the stripe lock picked by its hash. Threads that
+// insert the same string therefore serialize, but threads that insert
+// different strings only race for empty slots, which they claim with a
+// compare-and-swap. Growing the table takes every stripe lock, rehashes the
+// entries into a new array and publishes it. A reader that misses in an
+// old array falls back to intern(), which re-checks the current array under
+// the stripe lock.
+
+intern_table::intern_table(size_t capacity)
+    : _table(capacity)
+    , _resizes(0)
+{
+}
+
+intern_table::~intern_table()
+{
+}
+
+uint32_t intern_table::hash_bytes(const char* utf8, size_t size)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t idx = 0; idx < size; idx++) {
+        hash ^= static_cast<uint8_t>(utf8[idx]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+string** intern_table::lookup(const char* utf8, size_t size, uint32_t hash) const
+{
+    auto* found = _table.find(hash, [&](const entry& e) {
+        return e.hash == hash && e.size == size && !memcmp(e.utf8, utf8, size);
+    });
+    if (!found) {
+        return nullptr;
+    }
+    return &found->value;
+}
+
+string** intern_table::intern(const char* utf8, size_t size, uint32_t hash)
+{
+    auto* slot = lookup(utf8, size, hash);
+    if (slot) {
+        return slot;
+    }
+    bool needs_grow;
+    {
+        std::lock_guard<std::mutex> lock(_stripes[hash % nr_stripes].mutex);
+        slot = lookup(utf8, size, hash);
+        if (slot) {
+            return slot;
+        }
+        auto* e = static_cast<entry*>(malloc(sizeof(entry) + size));
+        if (!e) {
+            out_of_memory();
+        }
+        e->value = gc_new_string(utf8, size);
+        e->hash = hash;
+        e->size = size;
+        memcpy(e->utf8, utf8, size);
+        slot = &e->value;
+        auto new_size = _table.add(hash, e);
+        // Keep the load factor below 3/4 so that probe sequences stay short.
+        needs_grow = new_size * 4 > _table.capacity() * 3;
+    }
+    if (needs_grow) {
+        grow();
+    }
+    return slot;
+}
+
+void intern_table::grow()
+{
+    for (auto& s : _stripes) {
+        s.mutex.lock();
+    }
+    if (_table.size() * 4 > _table.capacity() * 3) {
+        _table.grow();
+        _resizes.fetch_add(1, std::memory_order_relaxed);
+    }
+    for (auto& s : _stripes) {
+        s.mutex.unlock();
+    }
+}
+
+void intern_table::for_each(const std::function<void(string**)>& fn) const
+{
+    _table.for_each([&](entry* e) { fn(&e->value); });
+}
+
+intern_table::stats intern_table::statistics() const
+{
+    stats ret = {};
+    size_t total_probe = 0;
+    ret.capacity = _table.capacity();
+    _table.for_each_probe([&](entry*, size_t probe) {
+        total_probe += probe;
+        ret.max_probe = std::max(ret.max_probe, probe);
+        ret.size++;
+    });
+    ret.avg_probe = ret.size ? static_cast<double>(total_probe) / ret.size : 0.0;
+    ret.resizes = _resizes.load(std::memory_order_relaxed);
+    return ret;
+}
+
+}
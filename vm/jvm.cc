@@ -3,11 +3,15 @@
 #include <hornet/java.hh>
 
 #include <unordered_map>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
 #include <mutex>
 
 namespace hornet {
 
 bool bootstrap_done = false;
+bool print_string_table_stats;
 std::shared_ptr<klass> java_lang_Class;
 std::shared_ptr<klass> java_lang_String;
 jvm *_jvm;
@@ -23,36 +27,65 @@ void jvm::init()
     if (!java_lang_String) {
         throw std::runtime_error("Unable to look up java/lang/String");
     }
+    string::init();
     bootstrap_done = true;
     java_lang_Class->link();
     java_lang_String->link();
     prim_post_init();
 }
 
-std::shared_ptr<klass> jvm::lookup_class(std::string name)
+std::shared_ptr<klass> jvm::lookup_class(symbol name)
 {
-    auto it = _classes.find(name);
-    if (it != _classes.end()) {
-        return it->second;
+    return _classes.lookup(name);
+}
+
+std::shared_ptr<klass> jvm::lookup_class(const std::string& name)
+{
+    auto sym = lookup_symbol(name);
+    if (!sym) {
+        return nullptr;
     }
-    return nullptr;
+    return lookup_class(sym);
+}
+
+std::shared_ptr<klass> jvm::register_class(std::shared_ptr<klass> klass)
+{
+    return _classes.insert(klass->name, klass);
+}
+
+string** jvm::intern_string(const char* utf8, size_t size, uint32_t hash)
+{
+    return _intern.intern(utf8, size, hash);
+}
+
+string** jvm::intern_string(const char* utf8, size_t size)
+{
+    return _intern.intern(utf8, size);
+}
+
+void jvm::for_each_class(const std::function<void(klass*)>& fn) const
+{
+    _classes.for_each(fn);
 }
 
-void jvm::register_class(std::shared_ptr<klass> klass)
+void jvm::for_each_interned_string(const std::function<void(string**)>& fn) const
 {
-    _classes.insert({klass->name, klass});
+    _intern.for_each(fn);
 }
 
-string* jvm::intern_string(std::string str)
+void jvm::intern_stats()
 {
-    std::lock_guard<std::mutex> lock(_intern_mutex);
-    auto it = _intern.find(str);
-    if (it == _intern.end()) {
-        auto intern = std::make_shared<string>(str.c_str());
-        _intern.insert({str, intern});
-        return intern.get();
+    if (!print_string_table_stats) {
+        return;
     }
-    return it->second.get();
+    auto stats = _intern.statistics();
+    fprintf(stderr, "String table statistics:\n");
+    fprintf(stderr, "  Number of entries    : %zu\n", stats.size);
+    fprintf(stderr, "  Capacity             : %zu\n", stats.capacity);
+    fprintf(stderr, "  Load factor          : %.3f\n", static_cast<double>(stats.size) / stats.capacity);
+    fprintf(stderr, "  Average probe length : %.3f\n", stats.avg_probe);
+    fprintf(stderr, "  Maximum probe length : %zu\n", stats.max_probe);
+    fprintf(stderr, "  Resizes              : %zu\n", stats.resizes);
 }
 
 }
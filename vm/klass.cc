@@ -2,26 +2,67 @@
 
 #include "hornet/java.hh"
 
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
 #include <string>
 
 namespace hornet {
 
-klass::klass(const std::string& name_, loader *loader, std::shared_ptr<constant_pool> const_pool)
+#ifdef CONFIG_COMPRESSED_KLASS
+static constexpr uint32_t max_klasses = 1 << 20;
+
+klass* klass_table[max_klasses];
+
+static std::atomic<uint32_t> nr_klasses{0};
+
+static uint32_t klass_table_add(klass* klass)
+{
+    auto id = nr_klasses++;
+    if (id >= max_klasses) {
+        throw std::runtime_error("too many classes");
+    }
+    klass_table[id] = klass;
+    return id;
+}
+#endif
+
+klass::klass(symbol name_, loader *loader, std::shared_ptr<constant_pool> const_pool)
     : object(nullptr)
     , name(name_)
     , super(nullptr)
-    , nr_fields(0)
+    , access_flags(0)
+    , init_thread(nullptr)
+#ifdef CONFIG_COMPRESSED_KLASS
+    , id(klass_table_add(this))
+#endif
+    , instance_size(object_header_size)
+    , super_depth(0)
+    , primary_supers()
+    , secondary_super_cache(nullptr)
+    , contended(false)
+    , layout(layout_kind::instance)
     , _const_pool(const_pool)
+    , _cp_cache(const_pool ? const_pool->size() : 0)
     , _loader(loader)
+    , _array_class(nullptr)
 {
 }
 
 klass::~klass()
 {
+#ifdef CONFIG_COMPRESSED_KLASS
+    klass_table[id] = nullptr;
+#endif
 }
 
 void klass::link()
 {
+    link_supers();
+    link_vtable();
+    link_itables();
+    link_oop_map();
     if (!bootstrap_done) {
         return;
     }
@@ -30,7 +71,203 @@ void klass::link()
     // GNU Classpath, it's in the vmdata field.
 }
 
-void klass::add(std::shared_ptr<klass> iface)
+// Virtual methods inherit the vtable index of the superclass method they
+// override. New virtual methods are appended to the end of the vtable.
+void klass::link_vtable()
+{
+    if (is_interface()) {
+        int32_t idx = 0;
+        for (auto method : _methods) {
+            if (method->is_virtual()) {
+                method->itable_index = idx++;
+            }
+        }
+        return;
+    }
+    // Classes that are loaded during bootstrap are linked twice.
+    vtable.clear();
+    if (super) {
+        vtable = super->vtable;
+    }
+    for (auto method : _methods) {
+        if (!method->is_virtual()) {
+            continue;
+        }
+        method->vtable_index = -1;
+        for (size_t i = 0; i < vtable.size(); i++) {
+            if (vtable[i]->matches(method->name, method->descriptor)) {
+                method->vtable_index = i;
+                vtable[i] = method.get();
+                break;
+            }
+        }
+        if (method->vtable_index < 0) {
+            method->vtable_index = vtable.size();
+            vtable.push_back(method.get());
+        }
+    }
+}
+
+static void collect_interfaces(klass* klass, std::vector<hornet::klass*>& result)
+{
+    for (auto iface : klass->interfaces) {
+        if (std::find(result.begin(), result.end(), iface) == result.end()) {
+            result.push_back(iface);
+            collect_interfaces(iface, result);
+        }
+    }
+}
+
+// The primary supers display is inherited from the superclass and extended
+// with the class itself. Everything that does not fit the display goes to
+// the secondary supers, which are searched linearly.
+void klass::link_supers()
+{
+    std::fill(primary_supers, primary_supers + primary_super_limit, nullptr);
+    secondary_supers.clear();
+    if (super) {
+        std::copy(super->primary_supers, super->primary_supers + primary_super_limit, primary_supers);
+        for (auto* k : super->secondary_supers) {
+            if (!k->is_interface()) {
+                secondary_supers.push_back(k);
+            }
+        }
+    }
+    // Arrays of references are also subtypes of arrays of their element
+    // supertypes, which a display of superclasses cannot express.
+    if (is_interface() || is_array()) {
+        super_depth = primary_super_limit;
+        secondary_supers.push_back(this);
+    } else {
+        super_depth = super ? super->super_depth + 1 : 0;
+        if (super_depth < primary_super_limit) {
+            primary_supers[super_depth] = this;
+        } else {
+            secondary_supers.push_back(this);
+        }
+    }
+    std::vector<klass*> ifaces;
+    for (auto* k = this; k != nullptr; k = k->super) {
+        collect_interfaces(k, ifaces);
+    }
+    secondary_supers.insert(secondary_supers.end(), ifaces.begin(), ifaces.end());
+}
+
+bool klass::is_secondary_subtype_of(klass* k)
+{
+    if (secondary_super_cache.load(std::memory_order_relaxed) == k) {
+        return true;
+    }
+    for (auto* s : secondary_supers) {
+        if (s == k) {
+            secondary_super_cache.store(k, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    if (layout == layout_kind::object_array && k->layout == layout_kind::object_array) {
+        auto* elem_type = static_cast<array_klass*>(this)->elem_type();
+        if (elem_type->is_subtype_of(static_cast<array_klass*>(k)->elem_type())) {
+            secondary_super_cache.store(k, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Interface methods are implemented by the vtable method of the same name
+// and descriptor or, if there is none, by the default method of the
+// interface itself.
+void klass::link_itables()
+{
+    if (is_interface()) {
+        return;
+    }
+    itables.clear();
+    std::vector<klass*> ifaces;
+    for (auto* k = this; k != nullptr; k = k->super) {
+        collect_interfaces(k, ifaces);
+    }
+    for (auto* iface : ifaces) {
+        itable entry;
+        entry.iface = iface;
+        for (auto method : iface->_methods) {
+            if (method->itable_index < 0) {
+                continue;
+            }
+            hornet::method* target = nullptr;
+            for (auto* m : vtable) {
+                if (m->matches(method->name, method->descriptor)) {
+                    target = m;
+                    break;
+                }
+            }
+            if (!target && !method->is_abstract()) {
+                target = method.get();
+            }
+            entry.methods.push_back(target);
+        }
+        itables.push_back(entry);
+    }
+}
+
+method* klass::itable_method(method* desc)
+{
+    if (desc->itable_index < 0) {
+        // Interface calls to methods of java/lang/Object.
+        return vtable[desc->vtable_index];
+    }
+    for (auto& entry : itables) {
+        if (entry.iface == desc->klass) {
+            return entry.methods[desc->itable_index];
+        }
+    }
+    return nullptr;
+}
+
+void klass::link_oop_map()
+{
+    oop_map = super ? super->oop_map : std::vector<uint64_t>{};
+    for (auto&& field : _fields) {
+        if (field->is_static() || field->type != type::t_ref) {
+            continue;
+        }
+        auto slot = field->offset / heap_ref_size;
+        if (slot / 64 >= oop_map.size()) {
+            oop_map.resize(slot / 64 + 1);
+        }
+        oop_map[slot / 64] |= uint64_t(1) << (slot % 64);
+    }
+    std::vector<uint64_t> statics((static_values.size() + 63) / 64);
+    for (auto&& field : _fields) {
+        if (!field->is_static() || field->type != type::t_ref) {
+            continue;
+        }
+        statics[field->offset / 64] |= uint64_t(1) << (field->offset % 64);
+    }
+    static_oop_map = std::move(statics);
+}
+
+klass* klass::array_class()
+{
+    auto* result = _array_class.load(std::memory_order_acquire);
+    if (result) {
+        return result;
+    }
+    std::string array_name;
+    if (is_primitive()) {
+        array_name = std::string("[") + type_descriptor(get_type());
+    } else if (is_array_type_name(name.str())) {
+        array_name = "[" + name.str();
+    } else {
+        array_name = "[L" + name.str() + ";";
+    }
+    // The class dictionary makes sure that racing threads get the same class.
+    result = system_loader()->load_class(array_name).get();
+    _array_class.store(result, std::memory_order_release);
+    return result;
+}
+
+void klass::add(klass* iface)
 {
     interfaces.push_back(iface);
 }
@@ -38,40 +275,90 @@ void klass::add(std::shared_ptr<klass> iface)
 void klass::add(std::shared_ptr<field> field)
 {
     if (field->is_static()) {
-        auto offset = static_values.size();
-        static_values.reserve(offset + 1);
-        static_values[offset] = 0;
-        field->offset = offset;
-    } else {
-        auto offset = nr_fields;
-        field->offset = offset;
-        nr_fields++;
+        // Static values are 8-byte slots, so pad contended ones with slots.
+        size_t padding = field->contended ? contended_padding / sizeof(value_t) : 0;
+        static_values.resize(static_values.size() + padding);
+        field->offset = static_values.size();
+        static_values.push_back(0);
+        static_values.resize(static_values.size() + padding);
     }
     _fields.push_back(field);
 }
 
-void klass::add(std::shared_ptr<method> method)
+// Instance fields are laid out after the fields of the superclass in
+// declaration order, each aligned to its size. The fields of a @Contended
+// class and every @Contended field group are placed in blocks of their own
+// with padding before the block and after the last one, so that they never
+// share a cache line with other fields of the same or a neighbouring object.
+// The superclass therefore has to be set and all fields added before the
+// layout is computed.
+void klass::layout_fields()
 {
-    _methods.push_back(method);
+    std::vector<std::vector<field*>> blocks(1);
+    for (auto&& field : _fields) {
+        if (field->is_static()) {
+            continue;
+        }
+        if (!field->contended) {
+            blocks[0].push_back(field.get());
+            continue;
+        }
+        auto it = std::find_if(blocks.begin() + 1, blocks.end(), [&](const std::vector<hornet::field*>& block) {
+            return field->contended_group && block[0]->contended_group == field->contended_group;
+        });
+        if (it != blocks.end()) {
+            it->push_back(field.get());
+        } else {
+            blocks.push_back({field.get()});
+        }
+    }
+    bool padded = false;
+    for (size_t idx = 0; idx < blocks.size(); idx++) {
+        if (blocks[idx].empty()) {
+            continue;
+        }
+        if (idx > 0 || contended) {
+            instance_size += contended_padding;
+            padded = true;
+        }
+        for (auto* field : blocks[idx]) {
+            auto size = field->size();
+            auto offset = (instance_size + size - 1) & ~(size - 1);
+            field->offset = offset;
+            instance_size = offset + size;
+        }
+    }
+    if (padded) {
+        instance_size += contended_padding;
+    }
 }
 
-uint32_t klass::nr_object_fields() const
+static enum intrinsic find_intrinsic(klass* klass, method* method)
 {
-    uint32_t nr = 0;
-    auto* k = this;
-    while (k != nullptr) {
-        nr += k->nr_fields;
-        k = k->super;
+    if (!method->is_native()) {
+        return intrinsic::none;
+    }
+    if (klass->name.str() == "java/lang/Object" && method->name.str() == "hashCode" && method->descriptor.str() == "()I") {
+        return intrinsic::object_hash_code;
     }
-    return nr;
+    if (klass->name.str() == "java/lang/System" && method->name.str() == "identityHashCode" && method->descriptor.str() == "(Ljava/lang/Object;)I") {
+        return intrinsic::system_identity_hash_code;
+    }
+    return intrinsic::none;
 }
 
-std::shared_ptr<klass> klass::load_class(std::string name)
+void klass::add(std::shared_ptr<method> method)
+{
+    method->intrinsic = find_intrinsic(this, method.get());
+    _methods.push_back(method);
+}
+
+std::shared_ptr<klass> klass::load_class(const std::string& name)
 {
     return _loader->load_class(name);
 }
 
-std::shared_ptr<field> klass::lookup_field(std::string name, std::string descriptor)
+std::shared_ptr<field> klass::lookup_field(symbol name, symbol descriptor)
 {
     klass* klass = this;
     while (klass) {
@@ -84,7 +371,7 @@ std::shared_ptr<field> klass::lookup_field(std::string name, std::string descrip
     return nullptr;
 }
 
-std::shared_ptr<method> klass::lookup_method_this(std::string name, std::string descriptor)
+std::shared_ptr<method> klass::lookup_method_this(symbol name, symbol descriptor)
 {
     for (auto method : _methods) {
         if (method->matches(name, descriptor))
@@ -93,11 +380,33 @@ std::shared_ptr<method> klass::lookup_method_this(std::string name, std::string
     return nullptr;
 }
 
-std::shared_ptr<method> klass::lookup_method(std::string name, std::string descriptor)
+// A string that is not in the symbol table cannot be the name or descriptor
+// of any method.
+std::shared_ptr<method> klass::lookup_method_this(const std::string& name, const std::string& descriptor)
+{
+    auto name_sym = lookup_symbol(name);
+    auto descriptor_sym = lookup_symbol(descriptor);
+    if (!name_sym || !descriptor_sym) {
+        return nullptr;
+    }
+    return lookup_method_this(name_sym, descriptor_sym);
+}
+
+std::shared_ptr<method> klass::lookup_method(const std::string& name, const std::string& descriptor)
+{
+    auto name_sym = lookup_symbol(name);
+    auto descriptor_sym = lookup_symbol(descriptor);
+    if (!name_sym || !descriptor_sym) {
+        return nullptr;
+    }
+    return lookup_method(name_sym, descriptor_sym);
+}
+
+std::shared_ptr<method> klass::lookup_method(symbol name, symbol descriptor)
 {
     klass* klass = this;
     while (klass) {
-        auto m = lookup_method_this(name, descriptor);
+        auto m = klass->lookup_method_this(name, descriptor);
         if (m) {
             return m;
         }
@@ -106,15 +415,27 @@ std::shared_ptr<method> klass::lookup_method(std::string name, std::string descr
     return nullptr;
 }
 
-std::shared_ptr<klass> klass::resolve_class(uint16_t idx)
+klass* klass::resolve_class(uint16_t idx)
 {
+    auto* klass = _cp_cache.get<hornet::klass>(idx);
+    if (klass) {
+        return klass;
+    }
     auto& klassref = _const_pool->get_class(idx);
     auto& klass_name = _const_pool->get_utf8(klassref.name_index);
-    return _loader->load_class(klass_name.bytes);
+    klass = _loader->load_class(klass_name.utf8_value).get();
+    if (!klass) {
+        return nullptr;
+    }
+    return _cp_cache.set(idx, klass);
 }
 
-std::shared_ptr<field> klass::resolve_field(uint16_t idx)
+field* klass::resolve_field(uint16_t idx)
 {
+    auto* field = _cp_cache.get<hornet::field>(idx);
+    if (field) {
+        return field;
+    }
     auto& fieldref = _const_pool->get_fieldref(idx);
     auto target_klass = resolve_class(fieldref.class_index);
     if (!target_klass) {
@@ -123,11 +444,19 @@ std::shared_ptr<field> klass::resolve_field(uint16_t idx)
     auto& field_name_and_type = _const_pool->get_name_and_type(fieldref.name_and_type_index);
     auto& field_name = _const_pool->get_utf8(field_name_and_type.name_index);
     auto& field_type = _const_pool->get_utf8(field_name_and_type.descriptor_index);
-    return target_klass->lookup_field(field_name.bytes, field_type.bytes);
+    field = target_klass->lookup_field(field_name.utf8_value, field_type.utf8_value).get();
+    if (!field) {
+        return nullptr;
+    }
+    return _cp_cache.set(idx, field);
 }
 
-std::shared_ptr<method> klass::resolve_method(uint16_t idx)
+method* klass::resolve_method(uint16_t idx)
 {
+    auto* method = _cp_cache.get<hornet::method>(idx);
+    if (method) {
+        return method;
+    }
     auto& methodref = _const_pool->get_methodref(idx);
     auto target_klass = resolve_class(methodref.class_index);
     if (!target_klass) {
@@ -136,11 +465,19 @@ std::shared_ptr<method> klass::resolve_method(uint16_t idx)
     auto& method_name_and_type = _const_pool->get_name_and_type(methodref.name_and_type_index);
     auto& method_name = _const_pool->get_utf8(method_name_and_type.name_index);
     auto& method_type = _const_pool->get_utf8(method_name_and_type.descriptor_index);
-    return target_klass->lookup_method(method_name.bytes, method_type.bytes);
+    method = target_klass->lookup_method(method_name.utf8_value, method_type.utf8_value).get();
+    if (!method) {
+        return nullptr;
+    }
+    return _cp_cache.set(idx, method);
 }
 
-std::shared_ptr<method> klass::resolve_interface_method(uint16_t idx)
+method* klass::resolve_interface_method(uint16_t idx)
 {
+    auto* method = _cp_cache.get<hornet::method>(idx);
+    if (method) {
+        return method;
+    }
     auto& methodref = _const_pool->get_interface_methodref(idx);
     auto target_klass = resolve_class(methodref.class_index);
     if (!target_klass) {
@@ -149,26 +486,64 @@ std::shared_ptr<method> klass::resolve_interface_method(uint16_t idx)
     auto& method_name_and_type = _const_pool->get_name_and_type(methodref.name_and_type_index);
     auto& method_name = _const_pool->get_utf8(method_name_and_type.name_index);
     auto& method_type = _const_pool->get_utf8(method_name_and_type.descriptor_index);
-    return target_klass->lookup_method(method_name.bytes, method_type.bytes);
+    method = target_klass->lookup_method(method_name.utf8_value, method_type.utf8_value).get();
+    if (!method) {
+        return nullptr;
+    }
+    return _cp_cache.set(idx, method);
+}
+
+string** klass::resolve_string(uint16_t idx)
+{
+    auto* slot = _cp_cache.get<string*>(idx);
+    if (slot) {
+        return slot;
+    }
+    return _cp_cache.set(idx, _const_pool->get_string(idx));
 }
 
+// Classes are initialized rarely, so all classes share one lock and one
+// condition variable for threads that wait for another thread's <clinit>.
+static std::mutex init_mutex;
+static std::condition_variable init_done;
+
 void klass::init()
 {
-    switch (state) {
-    case klass_state::loaded: {
-        state = klass_state::initialized;
-        auto clinit = lookup_method_this("<clinit>", "()V");
-        if (clinit) {
-            auto thread = hornet::thread::current();
-            auto new_frame = thread->make_frame(0);
-            hornet::_backend->execute(clinit.get(), *new_frame);
-            thread->free_frame(new_frame);
+    if (is_initialized()) {
+        return;
+    }
+    auto thread = hornet::thread::current();
+    {
+        std::unique_lock<std::mutex> lock(init_mutex);
+        for (;;) {
+            auto current = state.load(std::memory_order_acquire);
+            if (current == klass_state::initialized) {
+                return;
+            }
+            if (current == klass_state::loaded) {
+                break;
+            }
+            // The initializer itself refers to the class (JVMS 5.5 step 3).
+            if (init_thread == thread) {
+                return;
+            }
+            init_done.wait(lock);
         }
-        break;
+        init_thread = thread;
+        state.store(klass_state::initializing, std::memory_order_relaxed);
+    }
+    auto clinit = lookup_method_this("<clinit>", "()V");
+    if (clinit) {
+        auto new_frame = thread->make_frame(clinit.get());
+        hornet::_backend->execute(clinit.get(), *new_frame);
+        thread->free_frame(new_frame);
     }
-    case klass_state::initialized:
-        break;
+    {
+        std::lock_guard<std::mutex> lock(init_mutex);
+        init_thread = nullptr;
+        state.store(klass_state::initialized, std::memory_order_release);
     }
+    init_done.notify_all();
 }
 
 bool klass::verify()
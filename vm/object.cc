@@ -2,19 +2,425 @@
 
 #include "hornet/java.hh"
 
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+
 namespace hornet {
 
+// The mark word of an object is one of:
+//
+//   hash:31 | s:1 | 0:24 | age:4 | 00                  unlocked
+//   owner:32 | s:1 | 0:10 | recursion:15 | age:4 | 01  thin lock
+//   monitor* | 10                                      inflated lock
+//   address | 011                                      forwarded
+//   size | 111                                         padding
+//
+// A thin lock is taken and released with a single compare-and-swap. Its
+// owner is a thread id and the recursion count is the number of times the
+// owner has re-entered the lock. There is no room for the identity hash in a
+// thin lock, so the lock is inflated to a monitor when the object has a hash,
+// when another thread contends for it, when the recursion count overflows, or
+// when a thread waits on the object. An inflated monitor keeps the unlocked
+// mark word, with the hash and age, on the side.
+//
+// The s bit is set in java/lang/String instances that the VM creates with
+// their characters inline after the fields, which the GC sizes from their
+// length. Like the age, it is carried over whenever the mark word changes.
+//
+// The GC replaces the mark word with the new address of the object when it
+// moves the object. The mutator never sees a forwarded object. Objects are
+// 8-byte aligned, which leaves a third tag bit in forwarding addresses to tell
+// them apart from padding that fills unused space in the heap.
+
+static constexpr uintptr_t mark_tag_mask        = 0x3;
+static constexpr uintptr_t mark_unlocked        = 0x0;
+static constexpr uintptr_t mark_thin            = 0x1;
+static constexpr uintptr_t mark_inflated        = 0x2;
+static constexpr uintptr_t mark_forwarded       = 0x3;
+static constexpr uintptr_t mark_padding_mask    = 0x7;
+static constexpr uintptr_t mark_padding         = 0x7;
+static constexpr unsigned  mark_padding_shift   = 3;
+static constexpr unsigned  mark_age_shift       = 2;
+static constexpr uintptr_t mark_age_max         = 0xf;
+static constexpr uintptr_t mark_age_mask        = mark_age_max << mark_age_shift;
+static constexpr uintptr_t mark_vm_string       = uintptr_t(1) << 31;
+static constexpr uintptr_t mark_sticky_mask     = mark_age_mask | mark_vm_string;
+static constexpr unsigned  mark_hash_shift      = 32;
+static constexpr uintptr_t mark_hash_mask       = uintptr_t(0x7fffffff) << mark_hash_shift;
+static constexpr unsigned  thin_recursion_shift = 6;
+static constexpr uintptr_t thin_recursion_max   = 0x7fff;
+static constexpr uintptr_t thin_recursion_one   = uintptr_t(1) << thin_recursion_shift;
+static constexpr unsigned  thin_owner_shift     = 32;
+static constexpr int       lock_spin_count      = 100;
+
+static uintptr_t mark_tag(uintptr_t word)
+{
+    return word & mark_tag_mask;
+}
+
+// Returns a thin lock word for "owner" that keeps the age of "word".
+static uintptr_t thin_lock(uintptr_t word, uint32_t owner)
+{
+    return static_cast<uintptr_t>(owner) << thin_owner_shift | (word & mark_sticky_mask) | mark_thin;
+}
+
+static uint32_t thin_owner(uintptr_t word)
+{
+    return word >> thin_owner_shift;
+}
+
+static uintptr_t thin_recursion(uintptr_t word)
+{
+    return (word >> thin_recursion_shift) & thin_recursion_max;
+}
+
+// Heavyweight monitor of an inflated lock. The monitor tracks its owner
+// itself instead of holding "mutex" for the duration of the critical section,
+// so that a contending thread can inflate a lock on behalf of its owner.
+struct monitor {
+    std::mutex mutex;
+    std::condition_variable entry;
+    std::condition_variable waiters;
+    uint32_t owner;
+    uint32_t count;
+    /// Unlocked mark word of the object.
+    std::atomic<uintptr_t> displaced;
+
+    monitor()
+        : owner(0)
+        , count(0)
+        , displaced(0)
+    { }
+
+    void enter(uint32_t self) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (owner == self) {
+            count++;
+            return;
+        }
+        while (owner != 0) {
+            entry.wait(lock);
+        }
+        owner = self;
+        count = 1;
+    }
+
+    void exit(uint32_t self) {
+        std::unique_lock<std::mutex> lock(mutex);
+        assert(owner == self);
+        if (--count == 0) {
+            owner = 0;
+            entry.notify_one();
+        }
+    }
+
+    void wait(uint32_t self, int64_t millis) {
+        std::unique_lock<std::mutex> lock(mutex);
+        assert(owner == self);
+        auto saved_count = count;
+        owner = 0;
+        count = 0;
+        entry.notify_one();
+        if (millis > 0) {
+            waiters.wait_for(lock, std::chrono::milliseconds(millis));
+        } else {
+            waiters.wait(lock);
+        }
+        while (owner != 0) {
+            entry.wait(lock);
+        }
+        owner = self;
+        count = saved_count;
+    }
+
+    void notify(uint32_t self, bool all) {
+        std::unique_lock<std::mutex> lock(mutex);
+        assert(owner == self);
+        if (all) {
+            waiters.notify_all();
+        } else {
+            waiters.notify_one();
+        }
+    }
+};
+
+// Monitors are never deflated and live in a side table for the lifetime of
+// the VM. Objects move, so the table is not keyed by object address.
+static std::mutex monitor_table_mutex;
+static std::vector<std::unique_ptr<monitor>> monitor_table;
+
+static monitor* new_monitor()
+{
+    std::lock_guard<std::mutex> lock(monitor_table_mutex);
+    monitor_table.emplace_back(new monitor());
+    return monitor_table.back().get();
+}
+
+static monitor* inflated_monitor(uintptr_t word)
+{
+    return reinterpret_cast<monitor*>(word & ~mark_tag_mask);
+}
+
+// Replace mark word "word" with an inflated lock that is held by "owner"
+// "count" times. The monitor is not published until the compare-and-swap
+// succeeds, so it is reused by the caller if the mark word changed in the
+// meantime.
+static bool try_inflate(std::atomic<uintptr_t>& mark, uintptr_t word, monitor*& mon, uint32_t owner, uint32_t count, uintptr_t displaced)
+{
+    if (!mon) {
+        mon = new_monitor();
+    }
+    mon->owner = owner;
+    mon->count = count;
+    mon->displaced.store(displaced, std::memory_order_relaxed);
+    return mark.compare_exchange_strong(word, reinterpret_cast<uintptr_t>(mon) | mark_inflated, std::memory_order_acq_rel);
+}
+
 object::object(struct klass* klass_)
-    : fwd(nullptr)
-    , klass(klass_)
-    , _fields()
+    : mark(0)
+#ifdef CONFIG_COMPRESSED_KLASS
+    , _klass(klass_->id)
+#else
+    , _klass(klass_)
+#endif
 {
     assert(klass_ != nullptr);
-    _fields.resize(klass_->nr_object_fields());
 }
 
 object::~object()
 {
 }
 
+object* object::forwardee() const
+{
+    auto word = mark.load(std::memory_order_relaxed);
+    if (mark_tag(word) != mark_forwarded || (word & mark_padding_mask) == mark_padding) {
+        return nullptr;
+    }
+    return reinterpret_cast<object*>(word & ~mark_tag_mask);
+}
+
+void object::forward_to(object* to)
+{
+    mark.store(reinterpret_cast<uintptr_t>(to) | mark_forwarded, std::memory_order_relaxed);
+}
+
+void object::make_padding(void* addr, size_t size)
+{
+    auto* mark = static_cast<uintptr_t*>(addr);
+    *mark = (size << mark_padding_shift) | mark_padding;
+}
+
+size_t object::padding_size() const
+{
+    auto word = mark.load(std::memory_order_relaxed);
+    if ((word & mark_padding_mask) != mark_padding) {
+        return 0;
+    }
+    return word >> mark_padding_shift;
+}
+
+int32_t object::identity_hash()
+{
+    auto* word_ptr = &mark;
+    monitor* mon = nullptr;
+    int32_t hash = 0;
+    for (;;) {
+        auto word = word_ptr->load(std::memory_order_acquire);
+        switch (mark_tag(word)) {
+        case mark_unlocked: {
+            if (word & mark_hash_mask) {
+                return (word & mark_hash_mask) >> mark_hash_shift;
+            }
+            while (!hash) {
+                hash = thread::current()->next_hash() & 0x7fffffff;
+            }
+            auto next = word | static_cast<uintptr_t>(hash) << mark_hash_shift;
+            if (word_ptr->compare_exchange_weak(word, next, std::memory_order_relaxed)) {
+                return hash;
+            }
+            continue;
+        }
+        case mark_thin: {
+            // There is no room for the hash in a thin lock. Inflate the lock
+            // on behalf of its owner and install the hash in the monitor.
+            try_inflate(mark, word, mon, thin_owner(word), thin_recursion(word) + 1, word & mark_sticky_mask);
+            continue;
+        }
+        case mark_inflated: {
+            word_ptr = &inflated_monitor(word)->displaced;
+            continue;
+        }
+        default:
+            assert(0);
+        }
+    }
+}
+
+unsigned object::age() const
+{
+    auto word = mark.load(std::memory_order_acquire);
+    switch (mark_tag(word)) {
+    case mark_inflated:
+        word = inflated_monitor(word)->displaced.load(std::memory_order_relaxed);
+        break;
+    case mark_forwarded:
+        return forwardee()->age();
+    }
+    return (word & mark_age_mask) >> mark_age_shift;
+}
+
+void object::set_vm_string()
+{
+    mark.store(mark.load(std::memory_order_relaxed) | mark_vm_string, std::memory_order_relaxed);
+}
+
+bool object::is_vm_string() const
+{
+    auto word = mark.load(std::memory_order_acquire);
+    switch (mark_tag(word)) {
+    case mark_inflated:
+        word = inflated_monitor(word)->displaced.load(std::memory_order_relaxed);
+        break;
+    case mark_forwarded:
+        return forwardee()->is_vm_string();
+    }
+    return word & mark_vm_string;
+}
+
+void object::increment_age()
+{
+    auto* word_ptr = &mark;
+    for (;;) {
+        auto word = word_ptr->load(std::memory_order_acquire);
+        if (mark_tag(word) == mark_inflated) {
+            word_ptr = &inflated_monitor(word)->displaced;
+            continue;
+        }
+        assert(mark_tag(word) != mark_forwarded);
+        if ((word & mark_age_mask) == mark_age_mask) {
+            return;
+        }
+        auto next = word + (uintptr_t(1) << mark_age_shift);
+        if (word_ptr->compare_exchange_weak(word, next, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+void object::lock()
+{
+    auto self = thread::current()->id;
+    auto expected = mark.load(std::memory_order_relaxed) & mark_sticky_mask;
+    if (mark.compare_exchange_strong(expected, thin_lock(expected, self), std::memory_order_acquire)) {
+        return;
+    }
+    lock_slow(self);
+}
+
+void object::lock_slow(uint32_t self)
+{
+    monitor* mon = nullptr;
+    int spins = 0;
+    for (;;) {
+        auto word = mark.load(std::memory_order_acquire);
+        switch (mark_tag(word)) {
+        case mark_unlocked: {
+            if (word & mark_hash_mask) {
+                if (try_inflate(mark, word, mon, self, 1, word)) {
+                    return;
+                }
+                continue;
+            }
+            if (mark.compare_exchange_weak(word, thin_lock(word, self), std::memory_order_acquire)) {
+                return;
+            }
+            continue;
+        }
+        case mark_inflated: {
+            inflated_monitor(word)->enter(self);
+            return;
+        }
+        case mark_thin: {
+            auto owner = thin_owner(word);
+            auto recursion = thin_recursion(word);
+            if (owner == self && recursion < thin_recursion_max) {
+                // Only inflating threads race with the owner for the mark word.
+                if (mark.compare_exchange_weak(word, word + thin_recursion_one, std::memory_order_relaxed)) {
+                    return;
+                }
+                continue;
+            }
+            if (owner != self && spins++ < lock_spin_count) {
+                std::this_thread::yield();
+                continue;
+            }
+            // Inflate on behalf of the owner.
+            if (try_inflate(mark, word, mon, owner, recursion + 1, word & mark_sticky_mask)) {
+                mon->enter(self);
+                return;
+            }
+            continue;
+        }
+        default:
+            assert(0);
+        }
+    }
+}
+
+void object::unlock()
+{
+    auto self = thread::current()->id;
+    for (;;) {
+        auto word = mark.load(std::memory_order_acquire);
+        if (mark_tag(word) == mark_inflated) {
+            inflated_monitor(word)->exit(self);
+            return;
+        }
+        assert(mark_tag(word) == mark_thin && thin_owner(word) == self);
+        auto recursion = thin_recursion(word);
+        auto next = recursion ? word - thin_recursion_one : word & mark_sticky_mask;
+        // The compare-and-swap fails only if a contending thread inflated
+        // the lock, in which case the monitor is released instead.
+        if (mark.compare_exchange_weak(word, next, std::memory_order_release)) {
+            return;
+        }
+    }
+}
+
+// Inflate a lock that is held by the current thread.
+monitor* object::inflate(uint32_t self)
+{
+    monitor* mon = nullptr;
+    for (;;) {
+        auto word = mark.load(std::memory_order_acquire);
+        if (mark_tag(word) == mark_inflated) {
+            return inflated_monitor(word);
+        }
+        assert(mark_tag(word) == mark_thin && thin_owner(word) == self);
+        if (try_inflate(mark, word, mon, self, thin_recursion(word) + 1, word & mark_sticky_mask)) {
+            return mon;
+        }
+    }
+}
+
+void object::wait(int64_t millis)
+{
+    auto self = thread::current()->id;
+    inflate(self)->wait(self, millis);
+}
+
+void object::notify()
+{
+    auto self = thread::current()->id;
+    inflate(self)->notify(self, false);
+}
+
+void object::notify_all()
+{
+    auto self = thread::current()->id;
+    inflate(self)->notify(self, true);
+}
+
 }
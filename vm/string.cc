@@ -0,0 +1,122 @@
+#include "hornet/vm.hh"
+
+#include "hornet/java.hh"
+
+#include <algorithm>
+
+namespace hornet {
+
+size_t string::payload_offset;
+
+// Strings are decoded from the modified UTF-8 used by class files and JNI,
+// where a character is encoded in one to three bytes, NUL is encoded as two
+// bytes, and supplementary characters are encoded as surrogate pairs.
+
+static size_t utf8_seq_length(uint8_t lead)
+{
+    if (lead < 0x80) {
+        return 1;
+    }
+    if ((lead & 0xe0) == 0xc0) {
+        return 2;
+    }
+    return 3;
+}
+
+static uint16_t utf8_decode_char(const uint8_t* p, size_t len)
+{
+    switch (len) {
+    case 1:
+        return p[0];
+    case 2:
+        return ((p[0] & 0x1f) << 6) | (p[1] & 0x3f);
+    default:
+        return ((p[0] & 0x0f) << 12) | ((p[1] & 0x3f) << 6) | (p[2] & 0x3f);
+    }
+}
+
+uint32_t string::utf8_length(const char* utf8, size_t size, string_coder& coder)
+{
+    auto* p = reinterpret_cast<const uint8_t*>(utf8);
+    auto* end = p + size;
+    uint32_t length = 0;
+    coder = string_coder::latin1;
+    while (p < end) {
+        auto len = std::min(utf8_seq_length(*p), static_cast<size_t>(end - p));
+        if (utf8_decode_char(p, len) > 0xff) {
+            coder = string_coder::utf16;
+        }
+        p += len;
+        length++;
+    }
+    return length;
+}
+
+void string::decode_utf8(const char* utf8, size_t size)
+{
+    auto* payload = vm_payload();
+    auto* p = reinterpret_cast<const uint8_t*>(utf8);
+    auto* end = p + size;
+    auto* latin1 = reinterpret_cast<uint8_t*>(payload->data);
+    auto* utf16 = reinterpret_cast<uint16_t*>(payload->data);
+    for (uint32_t idx = 0; idx < payload->length; idx++) {
+        auto len = std::min(utf8_seq_length(*p), static_cast<size_t>(end - p));
+        auto ch = utf8_decode_char(p, len);
+        if (payload->coder == string_coder::latin1) {
+            latin1[idx] = ch;
+        } else {
+            utf16[idx] = ch;
+        }
+        p += len;
+    }
+}
+
+std::string string::to_utf8() const
+{
+    auto length = this->length();
+    std::string result;
+    result.reserve(length);
+    for (uint32_t idx = 0; idx < length; idx++) {
+        auto ch = char_at(idx);
+        if (ch != 0 && ch < 0x80) {
+            result.push_back(ch);
+        } else if (ch < 0x800) {
+            result.push_back(0xc0 | (ch >> 6));
+            result.push_back(0x80 | (ch & 0x3f));
+        } else {
+            result.push_back(0xe0 | (ch >> 12));
+            result.push_back(0x80 | ((ch >> 6) & 0x3f));
+            result.push_back(0x80 | (ch & 0x3f));
+        }
+    }
+    return result;
+}
+
+int32_t string::hash_code()
+{
+    auto* payload = vm_payload();
+    auto h = static_cast<uint32_t>(payload->hash.load(std::memory_order_relaxed));
+    if (h == 0) {
+        for (uint32_t idx = 0; idx < payload->length; idx++) {
+            h = 31 * h + char_at(idx);
+        }
+        // Racing threads compute the same value, so a plain store is enough.
+        payload->hash.store(static_cast<int32_t>(h), std::memory_order_relaxed);
+    }
+    return static_cast<int32_t>(h);
+}
+
+void string::init()
+{
+    auto align = alignof(payload);
+    payload_offset = (java_lang_String->instance_size + align - 1) & ~(align - 1);
+}
+
+size_t string::size(uint32_t length, string_coder coder)
+{
+    size_t chars = coder == string_coder::latin1 ? length : length * sizeof(uint16_t);
+
+    return payload_offset + offsetof(payload, data) + chars;
+}
+
+}
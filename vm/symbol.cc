@@ -0,0 +1,80 @@
+#include "hornet/symbol.hh"
+
+#include "hornet/concurrent_table.hh"
+
+#include <mutex>
+
+namespace hornet {
+
+// Symbols point to the strings in the table entries, which never move, and
+// are looked up without locks. Only inserting a new symbol takes the lock.
+
+namespace {
+
+struct entry {
+    size_t hash;
+    std::string str;
+};
+
+struct entry_traits {
+    static size_t hash(const entry& e) {
+        return e.hash;
+    }
+    static void destroy(entry* e) {
+        delete e;
+    }
+};
+
+struct symbol_table {
+    concurrent_table<entry, entry_traits> entries{4096};
+    std::mutex insert_mutex;
+};
+
+}
+
+// Symbols are interned by static initializers in other files, so the table
+// is constructed on first use. It is never destroyed because symbols must
+// stay valid until the process exits.
+static symbol_table& table()
+{
+    static auto* table = new symbol_table;
+    return *table;
+}
+
+static entry* find(const symbol_table& table, const std::string& str, size_t hash)
+{
+    return table.entries.find(hash, [&](const entry& e) {
+        return e.hash == hash && e.str == str;
+    });
+}
+
+symbol intern(const std::string& str)
+{
+    auto& table = hornet::table();
+    auto hash = std::hash<std::string>()(str);
+    if (auto* found = find(table, str, hash)) {
+        return symbol(&found->str);
+    }
+    std::lock_guard<std::mutex> lock(table.insert_mutex);
+    if (auto* found = find(table, str, hash)) {
+        return symbol(&found->str);
+    }
+    auto* e = new entry{hash, str};
+    auto size = table.entries.add(hash, e);
+    // Keep the load factor below 1/2 so that lookups rarely probe.
+    if (size * 2 > table.entries.capacity()) {
+        table.entries.grow();
+    }
+    return symbol(&e->str);
+}
+
+symbol lookup_symbol(const std::string& str)
+{
+    auto* found = find(table(), str, std::hash<std::string>()(str));
+    if (!found) {
+        return symbol();
+    }
+    return symbol(&found->str);
+}
+
+}
@@ -3,19 +3,52 @@
 #include "hornet/system_error.hh"
 
 #include <sys/mman.h>
+#include <atomic>
 
 namespace hornet {
 
+static std::atomic<uint32_t> next_thread_id{1};
+
 thread::thread()
-    : _stack(mmap_stack(_stack_max))
+    : exception(nullptr)
+    , id(next_thread_id++)
+    , _stack_pos(0)
+    , _stack(mmap_stack(_stack_max))
+    , _hash_state(id * 0x9e3779b1)
+    , _alloc_point(nullptr)
+    , _gc_thread(nullptr)
+    , _gc_root(nullptr)
+    , _top_frame(nullptr)
 {
 }
 
 thread::~thread()
 {
+    detach();
     munmap_stack(_stack, _stack_max);
 }
 
+void thread::attach()
+{
+    if (!_alloc_point) {
+        _gc_thread = gc_register_thread();
+        _gc_root = gc_create_thread_root(this);
+        _alloc_point = gc_create_alloc_point();
+    }
+}
+
+void thread::detach()
+{
+    if (_alloc_point) {
+        gc_destroy_alloc_point(_alloc_point);
+        gc_destroy_thread_root(_gc_root);
+        gc_deregister_thread(_gc_thread);
+        _alloc_point = nullptr;
+        _gc_root = nullptr;
+        _gc_thread = nullptr;
+    }
+}
+
 char* thread::mmap_stack(size_t size)
 {
     auto* p = mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);